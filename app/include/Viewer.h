@@ -44,6 +44,11 @@ class Viewer : public QWidget {
      */
     QLabel* duration_text_;
 
+    /**
+     * Label to display the render counters of the current frame.
+     */
+    QLabel* stats_text_;
+
     /**
      * Tracer object.
      */
@@ -63,16 +68,31 @@ class Viewer : public QWidget {
     Viewer(std::shared_ptr<PathTracer> raytracer,
            std::shared_ptr<Scene> scene,
            QLabel* duration_text,
+           QLabel* stats_text,
            QWidget* parent);
 
     ~Viewer() override;
 
     /**
-     * Changes the sample count per pixel and restarts the tracing.
+     * Changes the sample count per pixel and restarts the tracing. Disables the time budget and
+     * the error target.
      * @param samples
      */
     void setSampleCount(size_t samples);
 
+    /**
+     * Renders every frame for the given wall-clock time and restarts the tracing.
+     * @param seconds time budget of a frame
+     */
+    void setTimeBudget(double seconds);
+
+    /**
+     * Renders every frame until the estimated relative error reaches the target and restarts the
+     * tracing.
+     * @param error relative error target
+     */
+    void setErrorTarget(double error);
+
     /**
      * Changes the scene and restarts the tracing.
      * @param setting scene specification
@@ -23,10 +23,12 @@ Gui::Gui(const int width,
          QWindow*)
 {
     auto* duration_text = new QLabel(this);
-    viewer_ = new Viewer(std::move(raytracer), std::move(scene), duration_text, this);
+    auto* stats_text = new QLabel(this);
+    viewer_ = new Viewer(std::move(raytracer), std::move(scene), duration_text, stats_text, this);
     this->setCentralWidget(viewer_);
 
-    statusBar()->insertPermanentWidget(0, duration_text);
+    statusBar()->insertPermanentWidget(0, stats_text);
+    statusBar()->insertPermanentWidget(1, duration_text);
 
     const auto save_callback = [this]() {
         const auto filename = QFileDialog::getSaveFileName(this, tr("Save Image"), "render.png",
@@ -60,6 +62,31 @@ Gui::Gui(const int width,
         samples_menu->addAction(action);
     }
 
+    auto* time_menu = menuBar()->addMenu(tr("&Time budget"));
+    std::array<double, 6> budgets = {1, 5, 10, 30, 60, 300};
+    for (auto budget : budgets) {
+        std::string num = std::to_string(static_cast<int>(budget));
+        const auto action = new QAction(tr((num + " s").c_str()), this);
+        action->setStatusTip(tr(("Render every frame for " + num + " seconds.").c_str()));
+        connect(action, &QAction::triggered, this,
+                std::bind(&Viewer::setTimeBudget, viewer_, budget));
+
+        time_menu->addAction(action);
+    }
+
+    auto* quality_menu = menuBar()->addMenu(tr("&Quality"));
+    std::array<int, 5> percentages = {20, 10, 5, 2, 1};
+    for (auto percentage : percentages) {
+        std::string num = std::to_string(percentage);
+        const auto action = new QAction(tr((num + " % error").c_str()), this);
+        action->setStatusTip(
+            tr(("Render until the estimated relative error is " + num + " %.").c_str()));
+        connect(action, &QAction::triggered, this,
+                std::bind(&Viewer::setErrorTarget, viewer_, percentage / 100.0));
+
+        quality_menu->addAction(action);
+    }
+
     struct SceneMenuEntry {
         const char* title;
         const char* status_tip;
@@ -16,17 +16,28 @@
 
 #include "Viewer.h"
 
+#include <iomanip>
+#include <sstream>
+
 Viewer::Viewer(std::shared_ptr<PathTracer> raytracer,
                std::shared_ptr<Scene> scene,
                QLabel* duration_text,
+               QLabel* stats_text,
                QWidget* parent)
-    : QWidget(parent), duration_text_(duration_text), raytracer_(std::move(raytracer)),
-      scene_(std::move(scene))
+    : QWidget(parent), duration_text_(duration_text), stats_text_(stats_text),
+      raytracer_(std::move(raytracer)), scene_(std::move(scene))
 {
     timer_ = new QTimer(this);
     timer_->setInterval(32);
     timer_->start();
-    const auto repaint_callback = [this]() { this->repaint(); };
+    const auto repaint_callback = [this]() {
+        const auto progress = raytracer_->getProgress();
+        std::ostringstream text;
+        text << raytracer_->getStats().summary() << std::fixed << std::setprecision(1) << " | "
+             << progress.samples_per_pixel << " spp | error " << 100 * progress.error << " %";
+        stats_text_->setText(QString::fromStdString(text.str()));
+        this->repaint();
+    };
     connect(timer_, &QTimer::timeout, repaint_callback);
 }
 
@@ -36,6 +47,24 @@ void Viewer::setSampleCount(size_t samples)
 {
     stopRaytrace();
     raytracer_->setSampleCount(samples);
+    raytracer_->setTimeBudget(0);
+    raytracer_->setErrorTarget(0);
+    startRaytrace();
+}
+
+void Viewer::setTimeBudget(const double seconds)
+{
+    stopRaytrace();
+    raytracer_->setErrorTarget(0);
+    raytracer_->setTimeBudget(seconds);
+    startRaytrace();
+}
+
+void Viewer::setErrorTarget(const double error)
+{
+    stopRaytrace();
+    raytracer_->setTimeBudget(0);
+    raytracer_->setErrorTarget(error);
     startRaytrace();
 }
 
@@ -44,6 +73,7 @@ void Viewer::setScene(const SceneSetting setting)
     stopRaytrace();
     scene_->useSceneSetting(setting);
     raytracer_->setScene(scene_->getTree());
+    raytracer_->setLights(scene_->getLights());
     startRaytrace();
 }
 
@@ -70,6 +70,7 @@ int main(int argc, char** argv)
     scene->addCornellBox().addCornellContent();
 
     auto raytracer = std::make_shared<PathTracer>(camera, scene->getTree());
+    raytracer->setLights(scene->getLights());
 
     Gui window(500, 500, std::move(raytracer), std::move(scene));
     window.show();
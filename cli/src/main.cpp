@@ -0,0 +1,295 @@
+/**
+ *    Copyright 2020 Jannik Bamberger
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#include "Camera.h"
+#include "PathTracer.h"
+#include "Scene.h"
+#include <QCommandLineParser>
+#include <QCoreApplication>
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <cmath>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <string>
+
+constexpr const char* app_name = "PathTracerCli";
+constexpr const char* app_version = "v1.0.0";
+constexpr const char* app_description =
+    "Headless batch renderer of the PathTracer written for Global Illumination Methods WS1920";
+
+struct SceneName {
+    const char* name;
+    SceneSetting scene;
+};
+
+constexpr std::array<SceneName, 6> scene_names = {
+    SceneName{"empty", SceneSetting::Empty}, SceneName{"cornell", SceneSetting::Cornell},
+    SceneName{"exam", SceneSetting::Exam},   SceneName{"pig", SceneSetting::Pig},
+    SceneName{"cow", SceneSetting::Cow},     SceneName{"dragon", SceneSetting::Dragon}};
+
+struct SamplerName {
+    const char* name;
+    SamplerType sampler;
+};
+
+constexpr std::array<SamplerName, 4> sampler_names = {
+    SamplerName{"independent", SamplerType::Independent},
+    SamplerName{"stratified", SamplerType::Stratified}, SamplerName{"halton", SamplerType::Halton},
+    SamplerName{"sobol", SamplerType::Sobol}};
+
+/**
+ * Reads a positive integer option and terminates with the help text if the value is invalid.
+ */
+static int readPositive(QCommandLineParser& parser,
+                        const QCommandLineOption& option,
+                        const bool allow_zero = false)
+{
+    bool ok = false;
+    const auto value = parser.value(option).toInt(&ok);
+    if (!ok || value < 0 || (value == 0 && !allow_zero)) {
+        std::cerr << "Invalid value " << parser.value(option).toStdString() << "." << std::endl;
+        parser.showHelp(EXIT_FAILURE);
+    }
+    return value;
+}
+
+/**
+ * Reads a 64 bit seed and terminates with the help text if the value is invalid.
+ */
+static uint64_t readSeed(QCommandLineParser& parser, const QCommandLineOption& option)
+{
+    bool ok = false;
+    const auto value = parser.value(option).toULongLong(&ok);
+    if (!ok) {
+        std::cerr << "Invalid value " << parser.value(option).toStdString() << "." << std::endl;
+        parser.showHelp(EXIT_FAILURE);
+    }
+    return value;
+}
+
+/**
+ * Reads a non-negative floating point option and terminates with the help text if it is invalid.
+ */
+static double readNonNegative(QCommandLineParser& parser, const QCommandLineOption& option)
+{
+    bool ok = false;
+    const auto value = parser.value(option).toDouble(&ok);
+    if (!ok || !(value >= 0)) {
+        std::cerr << "Invalid value " << parser.value(option).toStdString() << "." << std::endl;
+        parser.showHelp(EXIT_FAILURE);
+    }
+    return value;
+}
+
+int main(int argc, char** argv)
+{
+    // The core application only provides the argument handling, no event loop is started.
+    QCoreApplication app(argc, argv);
+    QCoreApplication::setApplicationName(app_name);
+    QCoreApplication::setApplicationVersion(app_version);
+
+    QCommandLineParser parser;
+    parser.setApplicationDescription(app_description);
+    parser.addHelpOption();
+    parser.addVersionOption();
+    parser.addPositionalArgument("share_dir",
+                                 "Directory containing the share files (objects, textures, ...).");
+    const QCommandLineOption scene_option(
+        QStringList{"s", "scene"}, "Scene to render (empty, cornell, exam, pig, cow, dragon).",
+        "scene", "cornell");
+    const QCommandLineOption width_option("width", "Image width in pixels.", "pixels", "500");
+    const QCommandLineOption height_option("height", "Image height in pixels.", "pixels", "500");
+    const QCommandLineOption samples_option("spp", "Samples per pixel.", "samples", "2048");
+    const QCommandLineOption threads_option(
+        QStringList{"t", "threads"}, "Number of render threads, 0 uses all cores.", "threads", "0");
+    const QCommandLineOption min_depth_option(
+        "min-depth", "Bounces before the russian roulette may end a path.", "bounces", "3");
+    const QCommandLineOption max_depth_option("max-depth", "Maximum bounces per path.", "bounces",
+                                              "64");
+    const QCommandLineOption adaptive_option(
+        "adaptive",
+        "Relative noise threshold of the adaptive sampling, 0 samples all pixels equally. The "
+        "sample count then is the average budget per pixel.",
+        "threshold", "0");
+    const QCommandLineOption time_option(
+        "time", "Render until the time budget is spent instead of a fixed sample count.", "seconds",
+        "0");
+    const QCommandLineOption error_option(
+        "error", "Render until the estimated relative error is reached, e.g. 0.05.", "error", "0");
+    const QCommandLineOption sampler_option("sampler",
+                                            "Sample generator (independent, stratified, halton, "
+                                            "sobol).",
+                                            "sampler", "sobol");
+    const QCommandLineOption single_rays_option(
+        "single-rays", "Trace the primary rays one by one instead of in packets of 8x8 pixels.");
+    const QCommandLineOption seed_option(
+        "seed", "Seed of the random numbers. Renders with the same seed are identical.", "seed");
+    const QCommandLineOption output_option(QStringList{"o", "output"}, "Output image file.",
+                                           "file", "render.png");
+    parser.addOption(scene_option);
+    parser.addOption(width_option);
+    parser.addOption(height_option);
+    parser.addOption(samples_option);
+    parser.addOption(threads_option);
+    parser.addOption(min_depth_option);
+    parser.addOption(max_depth_option);
+    parser.addOption(adaptive_option);
+    parser.addOption(time_option);
+    parser.addOption(error_option);
+    parser.addOption(sampler_option);
+    parser.addOption(single_rays_option);
+    parser.addOption(seed_option);
+    const QCommandLineOption stats_option(
+        "stats", "Write the render counters and timings as JSON to the given file.", "file");
+    const QCommandLineOption heatmap_option(
+        "heatmap", "Write an image of the number of samples per pixel to the given file.", "file");
+    parser.addOption(output_option);
+    parser.addOption(stats_option);
+    parser.addOption(heatmap_option);
+    parser.process(app);
+
+    std::filesystem::path share_dir = "./share";
+    const auto pa = parser.positionalArguments();
+    if (!pa.isEmpty()) {
+        share_dir = pa[0].toStdString();
+    }
+    if (!std::filesystem::exists(share_dir)) {
+        std::cerr << "Share directory does not exist." << std::endl;
+        parser.showHelp(EXIT_FAILURE);
+    }
+
+    const auto scene_name = parser.value(scene_option).toLower().toStdString();
+    const auto entry = std::find_if(scene_names.begin(), scene_names.end(),
+                                    [&scene_name](const auto& s) { return scene_name == s.name; });
+    if (entry == scene_names.end()) {
+        std::cerr << "Unknown scene " << scene_name << "." << std::endl;
+        parser.showHelp(EXIT_FAILURE);
+    }
+
+    const auto sampler_name = parser.value(sampler_option).toLower().toStdString();
+    const auto sampler = std::find_if(
+        sampler_names.begin(), sampler_names.end(),
+        [&sampler_name](const auto& s) { return sampler_name == s.name; });
+    if (sampler == sampler_names.end()) {
+        std::cerr << "Unknown sampler " << sampler_name << "." << std::endl;
+        parser.showHelp(EXIT_FAILURE);
+    }
+
+    const auto width = readPositive(parser, width_option);
+    const auto height = readPositive(parser, height_option);
+    const auto samples = readPositive(parser, samples_option);
+    const auto threads = readPositive(parser, threads_option, true);
+    const auto min_depth = readPositive(parser, min_depth_option, true);
+    const auto max_depth = readPositive(parser, max_depth_option);
+    const auto adaptive = readNonNegative(parser, adaptive_option);
+    const auto time_budget = readNonNegative(parser, time_option);
+    const auto error_target = readNonNegative(parser, error_option);
+    const auto packets = !parser.isSet(single_rays_option);
+    const auto seeded = parser.isSet(seed_option);
+    const uint64_t seed = seeded ? readSeed(parser, seed_option) : 0;
+    const auto output = parser.value(output_option).toStdString();
+
+    using namespace std::chrono;
+
+    const auto t0 = steady_clock::now();
+    auto scene =
+        std::make_shared<Scene>(share_dir, glm::dvec3{-20, -20, -20}, glm::dvec3{20, 20, 20});
+    scene->useSceneSetting(entry->scene);
+    const auto t1 = steady_clock::now();
+
+    PathTracer tracer(Camera(glm::dvec3{14, 0, 0}), scene->getTree());
+    tracer.setLights(scene->getLights());
+    tracer.setSampleCount(samples);
+    tracer.setThreadCount(threads);
+    tracer.setSampler(sampler->sampler);
+    tracer.setBounceLimits(min_depth, max_depth);
+    tracer.setAdaptive(adaptive);
+    tracer.setTimeBudget(time_budget);
+    tracer.setErrorTarget(error_target);
+    tracer.setPacketTracing(packets);
+    if (seeded) {
+        tracer.setSeed(seed);
+    }
+    tracer.start();
+    tracer.run(width, height);
+    tracer.stop();
+    const auto t2 = steady_clock::now();
+
+    if (!tracer.getImage()->save(output)) {
+        std::cerr << "Could not write image to " << output << "." << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    const auto setup_time = duration<double>(t1 - t0).count();
+    const auto render_time = duration<double>(t2 - t1).count();
+    // the adaptive sampling traces a varying number of samples, each of them starts one path
+    const auto total_samples = static_cast<double>(tracer.getStats().pathCount());
+    std::cout << "Scene setup: " << setup_time << " seconds" << std::endl;
+    std::cout << "Rendering:   " << render_time << " seconds" << std::endl;
+    const auto progress = tracer.getProgress();
+    std::cout << "Throughput:  " << total_samples / render_time / 1e6 << " MSamples/s" << std::endl;
+    std::cout << "Achieved:    " << progress.samples_per_pixel << " spp, estimated error "
+              << progress.error << std::endl;
+    std::cout << "Saved " << output << std::endl;
+
+    if (parser.isSet(heatmap_option)) {
+        const auto heatmap_file = parser.value(heatmap_option).toStdString();
+        if (!tracer.getSampleHeatmap()->save(heatmap_file)) {
+            std::cerr << "Could not write heatmap to " << heatmap_file << "." << std::endl;
+            return EXIT_FAILURE;
+        }
+        std::cout << "Saved " << heatmap_file << std::endl;
+    }
+
+    if (parser.isSet(stats_option)) {
+        const auto stats_file = parser.value(stats_option).toStdString();
+        std::ofstream os(stats_file);
+        os << "{\n"
+           << "  \"scene\": \"" << entry->name << "\",\n"
+           << "  \"width\": " << width << ",\n"
+           << "  \"height\": " << height << ",\n"
+           << "  \"spp\": " << samples << ",\n"
+           << "  \"min_depth\": " << min_depth << ",\n"
+           << "  \"max_depth\": " << max_depth << ",\n"
+           << "  \"adaptive_threshold\": " << adaptive << ",\n"
+           << "  \"time_budget\": " << time_budget << ",\n"
+           << "  \"error_target\": " << error_target << ",\n"
+           << "  \"achieved_spp\": " << progress.samples_per_pixel << ",\n"
+           << "  \"error_estimate\": "
+           << (std::isfinite(progress.error) ? std::to_string(progress.error) : "null") << ",\n"
+           << "  \"sampler\": \"" << sampler->name << "\",\n"
+           << "  \"packets\": " << (packets ? "true" : "false") << ",\n"
+           << "  \"seed\": " << (seeded ? std::to_string(seed) : "null") << ",\n"
+           << "  \"setup_seconds\": " << setup_time << ",\n"
+           << "  \"render_seconds\": " << render_time << ",\n"
+           << "  \"counters\": ";
+        tracer.getStats().writeJson(os, "  ");
+        os << "\n}\n";
+        if (!os) {
+            std::cerr << "Could not write statistics to " << stats_file << "." << std::endl;
+            return EXIT_FAILURE;
+        }
+        std::cout << "Saved " << stats_file << std::endl;
+    }
+
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,281 @@
+/**
+ *    Copyright 2020 Jannik Bamberger
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <benchmark/benchmark.h>
+
+#include "BVH.h"
+#include "ObjReader.h"
+#include "RayPacket.h"
+#include <algorithm>
+#include <bitset>
+#include <glm/gtc/constants.hpp>
+#include <limits>
+#include <memory>
+#include <random>
+#include <thread>
+#include <vector>
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+/**
+ * The dragon is a scanned mesh with very uneven triangle sizes. It is loaded only once.
+ */
+static const obj::ObjContent& dragon()
+{
+    static const auto mesh = obj::readObjFile(RT_SHARE_DIR "/dragon-3.obj");
+    return mesh;
+}
+
+/**
+ * Rays start on a sphere around the mesh and point to random positions inside of its bounds.
+ */
+static std::vector<Ray> makeRays(const BoundingBox& bbox, size_t count)
+{
+    std::default_random_engine engine(42); // NOLINT(cert-msc32-c,cert-msc51-cpp)
+    std::uniform_real_distribution<double> dist(0, 1);
+
+    const auto center = (bbox.min + bbox.max) / 2.0;
+    const auto radius = glm::distance(bbox.min, bbox.max);
+
+    std::vector<Ray> rays;
+    rays.reserve(count);
+    for (size_t i = 0; i < count; i++) {
+        const auto phi = glm::two_pi<double>() * dist(engine);
+        const auto cos_theta = 2.0 * dist(engine) - 1.0;
+        const auto sin_theta = glm::sqrt(1.0 - cos_theta * cos_theta);
+        const glm::dvec3 origin =
+            center + radius * glm::dvec3{glm::cos(phi) * sin_theta, glm::sin(phi) * sin_theta,
+                                         cos_theta};
+        const glm::dvec3 target =
+            bbox.min + glm::dvec3{dist(engine), dist(engine), dist(engine)} * (bbox.max - bbox.min);
+        rays.emplace_back(origin, glm::normalize(target - origin));
+    }
+    return rays;
+}
+
+/**
+ * Creates a soup of small randomly oriented triangles in the unit cube. The triangle size shrinks
+ * with the count such that the density of overlapping triangles stays similar.
+ */
+static obj::ObjContent makeSoup(size_t count)
+{
+    std::default_random_engine engine(7); // NOLINT(cert-msc32-c,cert-msc51-cpp)
+    std::uniform_real_distribution<double> dist(0, 1);
+    const auto size = 2.0 / std::cbrt(static_cast<double>(count));
+    const auto point = [&] { return glm::dvec3{dist(engine), dist(engine), dist(engine)}; };
+
+    obj::ObjContent mesh;
+    mesh.reserve(count);
+    for (size_t i = 0; i < count; i++) {
+        const auto p = point();
+        mesh.emplace_back(p, p + size * (point() - 0.5), p + size * (point() - 0.5));
+    }
+    return mesh;
+}
+
+static void setThreads(int threads)
+{
+#ifdef _OPENMP
+    omp_set_num_threads(threads);
+#endif
+}
+
+/**
+ * Adds the thread counts 1, 2, 4, ... up to the number of cores to each set of arguments.
+ */
+static void threadSweep(benchmark::internal::Benchmark* b, const std::vector<int64_t>& args)
+{
+    const auto max_threads =
+        static_cast<int64_t>(std::max(1u, std::thread::hardware_concurrency()));
+    for (const auto arg : args) {
+        for (int64_t threads = 1; threads <= max_threads; threads *= 2) {
+            b->Args({arg, threads});
+        }
+    }
+}
+
+static void addStats(benchmark::State& state, const BVH& bvh)
+{
+    const auto stats = bvh.buildStats();
+    state.counters["sah_cost"] = stats.sah_cost;
+    state.counters["leaf_size"] = stats.average_leaf_size;
+    state.counters["depth"] = static_cast<double>(stats.max_depth);
+    state.counters["traversal_MB"] = static_cast<double>(stats.traversal_bytes) / (1 << 20);
+}
+
+/**
+ * Construction time of the dragon hierarchy with the given split method and number of threads.
+ */
+static void BM_BVHBuild(benchmark::State& state)
+{
+    const auto method = static_cast<BVH::SplitMethod>(state.range(0));
+    const auto& mesh = dragon();
+    setThreads(static_cast<int>(state.range(1)));
+
+    for (auto _ : state) {
+        const BVH bvh(mesh, 20, method);
+        benchmark::DoNotOptimize(bvh.boundingBox());
+    }
+    addStats(state, BVH(mesh, 20, method));
+    state.counters["triangles/s"] = benchmark::Counter(
+        static_cast<double>(mesh.size()), benchmark::Counter::kIsIterationInvariantRate);
+}
+BENCHMARK(BM_BVHBuild)
+    ->Apply([](auto* b) {
+        threadSweep(b, {static_cast<int>(BVH::SplitMethod::Median),
+                        static_cast<int>(BVH::SplitMethod::SAH)});
+    })
+    ->UseRealTime()
+    ->Unit(benchmark::kMillisecond);
+
+/**
+ * Construction time of the SAH hierarchy over large synthetic meshes. The mesh is created for
+ * every iteration and moved into the hierarchy, such that only one copy is kept in memory.
+ */
+static void BM_BVHBuildLarge(benchmark::State& state)
+{
+    const auto count = static_cast<size_t>(state.range(0));
+    setThreads(static_cast<int>(state.range(1)));
+
+    for (auto _ : state) {
+        state.PauseTiming();
+        auto mesh = makeSoup(count);
+        state.ResumeTiming();
+
+        const BVH bvh(std::move(mesh));
+        benchmark::DoNotOptimize(bvh.boundingBox());
+
+        state.PauseTiming();
+        addStats(state, bvh);
+        state.ResumeTiming();
+    }
+    state.counters["triangles/s"] = benchmark::Counter(
+        static_cast<double>(count), benchmark::Counter::kIsIterationInvariantRate);
+}
+BENCHMARK(BM_BVHBuildLarge)
+    ->Apply([](auto* b) { threadSweep(b, {1'000'000, 10'000'000}); })
+    ->Iterations(1)
+    ->UseRealTime()
+    ->Unit(benchmark::kMillisecond);
+
+/**
+ * Closest hit queries against the hierarchy built with the given split method.
+ */
+static void BM_BVHTraversal(benchmark::State& state)
+{
+    constexpr size_t ray_count = 1u << 14u;
+    const auto method = static_cast<BVH::SplitMethod>(state.range(0));
+    const BVH bvh(dragon(), 20, method);
+    const auto rays = makeRays(bvh.boundingBox(), ray_count);
+
+    size_t hits = 0;
+    for (auto _ : state) {
+        for (const auto& ray : rays) {
+            Hit hit;
+            hits += bvh.intersect(ray, hit) ? 1 : 0;
+        }
+    }
+    benchmark::DoNotOptimize(hits);
+
+    addStats(state, bvh);
+    state.counters["rays/s"] = benchmark::Counter(static_cast<double>(ray_count),
+                                                  benchmark::Counter::kIsIterationInvariantRate);
+}
+BENCHMARK(BM_BVHTraversal)
+    ->Arg(static_cast<int>(BVH::SplitMethod::Median))
+    ->Arg(static_cast<int>(BVH::SplitMethod::SAH))
+    ->Unit(benchmark::kMillisecond);
+
+/**
+ * Any hit queries with the same rays as BM_BVHTraversal, i.e. the cost of a shadow ray.
+ */
+static void BM_BVHOcclusion(benchmark::State& state)
+{
+    constexpr size_t ray_count = 1u << 14u;
+    const BVH bvh(dragon(), 20, BVH::SplitMethod::SAH);
+    const auto rays = makeRays(bvh.boundingBox(), ray_count);
+
+    size_t hits = 0;
+    for (auto _ : state) {
+        for (const auto& ray : rays) {
+            hits += bvh.occluded(ray, std::numeric_limits<double>::infinity()) ? 1 : 0;
+        }
+    }
+    benchmark::DoNotOptimize(hits);
+
+    state.counters["rays/s"] = benchmark::Counter(static_cast<double>(ray_count),
+                                                  benchmark::Counter::kIsIterationInvariantRate);
+}
+BENCHMARK(BM_BVHOcclusion)->Unit(benchmark::kMillisecond);
+
+/**
+ * Primary rays of a pinhole camera which looks at the mesh, ordered in blocks of 8x8 pixels. The
+ * rays are traced one by one (argument 0) or one packet per block (argument 1).
+ */
+static void BM_BVHCoherent(benchmark::State& state)
+{
+    constexpr int size = 256;
+    constexpr int block = 8;
+    const BVH bvh(dragon(), 20, BVH::SplitMethod::SAH);
+    const auto bbox = bvh.boundingBox();
+    const auto center = (bbox.min + bbox.max) / 2.0;
+    const auto extent = glm::distance(bbox.min, bbox.max) / 2.0;
+    const glm::dvec3 eye = center + glm::dvec3{0.3, -1.0, 0.4} * 1.5 * extent;
+    const auto forward = glm::normalize(center - eye);
+    const auto right = glm::normalize(glm::cross(forward, glm::dvec3{0, 0, 1}));
+    const auto up = glm::cross(right, forward);
+
+    std::vector<Ray> rays;
+    for (auto by = 0; by < size; by += block) {
+        for (auto bx = 0; bx < size; bx += block) {
+            for (auto y = by; y < by + block; y++) {
+                for (auto x = bx; x < bx + block; x++) {
+                    const auto u = (x + 0.5) / size - 0.5;
+                    const auto v = 0.5 - (y + 0.5) / size;
+                    rays.emplace_back(eye, forward + 0.8 * u * right + 0.8 * v * up);
+                }
+            }
+        }
+    }
+
+    const auto packets = state.range(0) != 0;
+    auto packet = std::make_unique<RayPacket>();
+    size_t hits = 0;
+    for (auto _ : state) {
+        for (size_t i = 0; i < rays.size(); i += block * block) {
+            if (packets) {
+                packet->clear();
+                for (size_t j = i; j < i + block * block; j++) {
+                    packet->add(rays[j]);
+                }
+                bvh.intersectPacket(*packet, packet->all());
+                hits += std::bitset<RayPacket::max_size>(packet->found).count();
+            } else {
+                for (size_t j = i; j < i + block * block; j++) {
+                    Hit hit;
+                    hits += bvh.intersect(rays[j], hit) ? 1 : 0;
+                }
+            }
+        }
+    }
+    benchmark::DoNotOptimize(hits);
+
+    state.counters["rays/s"] = benchmark::Counter(static_cast<double>(rays.size()),
+                                                  benchmark::Counter::kIsIterationInvariantRate);
+}
+BENCHMARK(BM_BVHCoherent)->Arg(0)->Arg(1)->Unit(benchmark::kMillisecond);
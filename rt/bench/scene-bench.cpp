@@ -0,0 +1,107 @@
+/**
+ *    Copyright 2020 Jannik Bamberger
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <benchmark/benchmark.h>
+
+#include "PathTracer.h"
+#include "Scene.h"
+#include <chrono>
+
+#ifdef _WIN32
+#define NOMINMAX
+// clang-format off
+#include <windows.h>
+#include <psapi.h>
+// clang-format on
+#else
+#include <sys/resource.h>
+#endif
+
+constexpr static auto width = 64;
+constexpr static auto height = 64;
+constexpr static auto samples = 16;
+constexpr static uint64_t seed = 42;
+
+/**
+ * Peak resident set size of the process in megabytes. The value never decreases, hence it is the
+ * maximum over all benchmarks which ran so far.
+ */
+static double peakMemoryMB()
+{
+#ifdef _WIN32
+    PROCESS_MEMORY_COUNTERS counters{};
+    GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters));
+    return static_cast<double>(counters.PeakWorkingSetSize) / (1024.0 * 1024.0);
+#else
+    rusage usage{};
+    getrusage(RUSAGE_SELF, &usage);
+#ifdef __APPLE__
+    return static_cast<double>(usage.ru_maxrss) / (1024.0 * 1024.0); // given in bytes
+#else
+    return static_cast<double>(usage.ru_maxrss) / 1024.0; // given in kilobytes
+#endif
+#endif
+}
+
+/**
+ * Renders one of the bundled scenes with a fixed seed, such that the runs are comparable.
+ */
+static void BM_Scene(benchmark::State& state, const SceneSetting setting)
+{
+    const auto t0 = std::chrono::steady_clock::now();
+    Scene scene(RT_SHARE_DIR, glm::dvec3{-20, -20, -20}, glm::dvec3{20, 20, 20});
+    scene.useSceneSetting(setting);
+    const auto t1 = std::chrono::steady_clock::now();
+
+    PathTracer tracer(Camera(glm::dvec3{14, 0, 0}), scene.getTree());
+    tracer.setLights(scene.getLights());
+    tracer.setSampleCount(samples);
+    tracer.setSeed(seed);
+
+    double rays = 0;
+    for (auto _ : state) {
+        tracer.start();
+        tracer.run(width, height);
+        tracer.stop();
+        rays += static_cast<double>(tracer.getStats().rayCount());
+    }
+
+    state.counters["rays/s"] = benchmark::Counter(rays, benchmark::Counter::kIsRate);
+    state.counters["samples/s"] =
+        benchmark::Counter(static_cast<double>(width * height * samples),
+                           benchmark::Counter::kIsIterationInvariantRate);
+    state.counters["setup_s"] = std::chrono::duration<double>(t1 - t0).count();
+    state.counters["bvh_build_s"] = scene.bvhBuildSeconds();
+    state.counters["peak_MB"] = peakMemoryMB();
+}
+BENCHMARK_CAPTURE(BM_Scene, empty, SceneSetting::Empty)
+    ->UseRealTime()
+    ->Unit(benchmark::kMillisecond);
+BENCHMARK_CAPTURE(BM_Scene, cornell, SceneSetting::Cornell)
+    ->UseRealTime()
+    ->Unit(benchmark::kMillisecond);
+BENCHMARK_CAPTURE(BM_Scene, exam, SceneSetting::Exam)
+    ->UseRealTime()
+    ->Unit(benchmark::kMillisecond);
+BENCHMARK_CAPTURE(BM_Scene, pig, SceneSetting::Pig)
+    ->UseRealTime()
+    ->Unit(benchmark::kMillisecond);
+BENCHMARK_CAPTURE(BM_Scene, cow, SceneSetting::Cow)
+    ->UseRealTime()
+    ->Unit(benchmark::kMillisecond);
+BENCHMARK_CAPTURE(BM_Scene, dragon, SceneSetting::Dragon)
+    ->UseRealTime()
+    ->Unit(benchmark::kMillisecond);
@@ -0,0 +1,71 @@
+/**
+ *    Copyright 2020 Jannik Bamberger
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#include <benchmark/benchmark.h>
+
+#include "PathTracer.h"
+#include "Scene.h"
+#include <algorithm>
+#include <chrono>
+#include <thread>
+
+constexpr static auto width = 128;
+constexpr static auto height = 128;
+constexpr static auto samples = 16;
+
+/**
+ * Renders the Cornell box with an increasing number of threads. The speedup counter relates the
+ * time per frame to the single threaded run.
+ */
+static void BM_ThreadSweep(benchmark::State& state)
+{
+    static double single_thread_seconds = 0;
+
+    const auto threads = static_cast<int>(state.range(0));
+    Scene scene("", glm::dvec3{-20, -20, -20}, glm::dvec3{20, 20, 20});
+    scene.addCornellBox().addCornellContent();
+
+    PathTracer tracer(Camera(glm::dvec3{14, 0, 0}), scene.getTree());
+    tracer.setLights(scene.getLights());
+    tracer.setSampleCount(samples);
+    tracer.setThreadCount(threads);
+
+    double seconds = 0;
+    for (auto _ : state) {
+        const auto t1 = std::chrono::steady_clock::now();
+        tracer.start();
+        tracer.run(width, height);
+        tracer.stop();
+        const auto t2 = std::chrono::steady_clock::now();
+        seconds += std::chrono::duration<double>(t2 - t1).count();
+    }
+    seconds /= static_cast<double>(state.iterations());
+
+    if (threads == 1) {
+        single_thread_seconds = seconds;
+    }
+    if (single_thread_seconds > 0) {
+        state.counters["speedup"] = single_thread_seconds / seconds;
+    }
+    state.counters["samples/s"] = benchmark::Counter(
+        static_cast<double>(width * height * samples), benchmark::Counter::kIsIterationInvariantRate);
+}
+BENCHMARK(BM_ThreadSweep)
+    ->RangeMultiplier(2)
+    ->Range(1, static_cast<int>(std::max(1u, std::thread::hardware_concurrency())))
+    ->UseRealTime()
+    ->Unit(benchmark::kMillisecond);
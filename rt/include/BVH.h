@@ -14,16 +14,104 @@
  * limitations under the License.
  */
 
+
 #pragma once
 
 #include "Entity.h"
+#include "TrianglePacket.h"
 #include <algorithm>
+#include <array>
+#include <cstdint>
 #include <vector>
 
 class BVH : public Entity {
-    class Node; // base class for the hierarchy tree
-    class LeafNode;
-    class InnerNode;
+  public:
+    /**
+     * Strategy used to split the triangles of a node during the construction.
+     */
+    enum class SplitMethod {
+        /// Sorts the triangles along a round-robin axis and splits at the median.
+        Median,
+        /// Chooses the binned split with the lowest surface area heuristic cost.
+        SAH,
+    };
+
+    /**
+     * Quality metrics of a built hierarchy.
+     */
+    struct BuildStats {
+        /// Expected cost of a ray which hits the root according to the surface area heuristic
+        double sah_cost = 0;
+        /// Average number of triangles per leaf
+        double average_leaf_size = 0;
+        /// Depth of the deepest leaf, the root has depth zero
+        size_t max_depth = 0;
+        /// Total number of nodes
+        size_t node_count = 0;
+        /// Number of leaf nodes
+        size_t leaf_count = 0;
+        /// Wall-clock time of the construction in seconds
+        double build_seconds = 0;
+        /// Size of the data read by the traversal, i.e. the nodes and the triangle packets
+        size_t traversal_bytes = 0;
+    };
+
+  private:
+    struct BuildNode;  // temporary hierarchy used during the construction
+    struct BuildRef;   // bounds of a triangle used during the construction
+    struct StackEntry; // node or leaf which waits for its traversal
+
+    /**
+     * Node of the flattened hierarchy with up to four children. The binary hierarchy of the
+     * construction is collapsed such that every node stores the bounds of its children in
+     * structure-of-arrays layout, which allows to test all children with one vectorized slab test.
+     * Leaves aren't stored as nodes, their packets are referenced by the slot in their parent.
+     * Unused slots have an empty box and are never entered. The bounds are rounded outwards to
+     * single precision which keeps the node at two cache lines.
+     */
+    struct alignas(64) WideNode {
+        constexpr static uint32_t width = 4;
+
+        std::array<std::array<float, width>, 3> min{};
+        std::array<std::array<float, width>, 3> max{};
+        std::array<uint32_t, width> child{}; // inner node: index in nodes_, leaf: first packet
+        std::array<uint16_t, width> count{}; // number of triangles of a leaf, 0 for inner nodes
+        uint8_t child_count = 0;             // number of used slots, the used slots come first
+    };
+    static_assert(sizeof(WideNode) == 128, "WideNode must fit into 128 bytes.");
+
+    /**
+     * Maximum depth of the hierarchy. This is also the size of the traversal stack.
+     */
+    constexpr static size_t max_depth_ = 64;
+
+    /**
+     * Size of the traversal stack. Every node replaces itself by at most four children.
+     */
+    constexpr static size_t stack_size_ = (WideNode::width - 1) * max_depth_ + 1;
+
+    /**
+     * Subtrees which are entered by less than this number of rays of a packet are traversed by
+     * every ray on its own.
+     */
+    constexpr static size_t packet_min_rays_ = 4;
+
+    /**
+     * Number of bins per axis which are evaluated by the SAH builder.
+     */
+    constexpr static size_t bin_count_ = 16;
+
+    /**
+     * Subtrees with at least this number of triangles are built in a separate task.
+     */
+    constexpr static size_t task_size_ = 4096;
+
+    /**
+     * Relative costs of a node traversal step and a packet intersection used by the SAH. A packet
+     * tests up to TrianglePacket::width triangles at once.
+     */
+    constexpr static double traversal_cost_ = 1.0;
+    constexpr static double intersection_cost_ = 1.0;
 
     /**
      * Nodes aren't split if they have less than this number of elements.
@@ -31,9 +119,37 @@ class BVH : public Entity {
     const size_t cutoff_size_;
 
     /**
-     * Root of the volume hierarchy.
+     * Strategy used to partition the triangles of inner nodes.
+     */
+    const SplitMethod split_method_;
+
+    /**
+     * The flattened hierarchy in depth-first order. The root is the first node.
+     */
+    std::vector<WideNode> nodes_;
+
+    /**
+     * The triangles of the leaves grouped into packets for the vectorized intersection. Each leaf
+     * references a contiguous range of packets, only the last packet of a leaf may be partially
+     * filled.
+     */
+    std::vector<TrianglePacket> packets_;
+
+    /**
+     * Shading data of the triangles in the order of the leaves. A triangle is only read when the
+     * hit is finalized or the triangle is sampled as light source.
+     */
+    std::vector<Triangle> primitives_;
+
+    /**
+     * Exact bounding box of all primitives.
+     */
+    BoundingBox bbox_;
+
+    /**
+     * Wall-clock time of the construction in seconds.
      */
-    std::unique_ptr<Node> root_;
+    double build_seconds_ = 0;
 
   public:
     /**
@@ -41,22 +157,136 @@ class BVH : public Entity {
      *
      * @param faces vector of faces for contained in the volume
      * @param cutoffSize maximum number of elements per node
+     * @param splitMethod strategy used to split the nodes
      */
-    explicit BVH(std::vector<Triangle> faces, size_t cutoffSize = 20);
+    explicit BVH(std::vector<Triangle> faces,
+                 size_t cutoffSize = 20,
+                 SplitMethod splitMethod = SplitMethod::SAH);
+
+    ~BVH() override;
 
     [[nodiscard]] BoundingBox boundingBox() const override;
 
     bool intersect(const Ray& ray, Hit& hit) const override;
 
-    void setMaterial(std::shared_ptr<Material> material) override;
+    [[nodiscard]] bool occluded(const Ray& ray, double t_max) const override;
+
+    /**
+     * Traverses the hierarchy once for all rays of the packet. Each node is tested against the
+     * interval bounds of the rays which entered it first, only if some ray may enter a child the
+     * rays are tested individually. Subtrees which few rays enter are traversed ray by ray.
+     */
+    void intersectPacket(RayPacket& packet, uint64_t active) const override;
+
+    void setMaterial(const Material* material) override;
+
+    void collectLights(std::vector<const Entity*>& lights) const override;
+
+    /**
+     * Computes quality metrics of the hierarchy. This allows to compare the split methods.
+     *
+     * @return metrics of the built hierarchy
+     */
+    [[nodiscard]] BuildStats buildStats() const;
 
   private:
     /**
-     * Creates a hierarchy from the given triangle list and returns the root node
+     * Finds the closest intersection of the ray with the triangles of the subtree.
+     *
+     * @param root index of the root of the subtree in nodes_
+     * @param ray the ray, its interval is cut off at a hit found before
+     * @param hit receives the closest hit, left untouched if there is no intersection
+     * @return true if the ray hits a triangle of the subtree
+     */
+    bool intersectSubtree(uint32_t root, const Ray& ray, Hit& hit) const;
+
+    /**
+     * Creates a hierarchy over the given range of triangle references and returns the root node.
+     * The references are reordered in place such that every subtree covers a contiguous range.
+     * Large subtrees are built in parallel tasks.
      *
      * @param depth the entry depth of the subtree
-     * @param faces triangles in the subtree
+     * @param refs bounds and indices of all triangles
+     * @param begin first reference in the subtree
+     * @param end one past the last reference in the subtree
      * @return root node of the subtree
      */
-    std::unique_ptr<Node> construct(size_t depth, std::vector<Triangle> faces);
+    std::unique_ptr<BuildNode>
+    construct(size_t depth, std::vector<BuildRef>& refs, size_t begin, size_t end) const;
+
+    /**
+     * Reorders the references such that the first part forms the first child and the remainder
+     * forms the second child.
+     *
+     * @param depth the depth of the node
+     * @param bbox bounding box of the triangles
+     * @param refs bounds and indices of all triangles
+     * @param begin first reference of the node
+     * @param end one past the last reference of the node
+     * @param axis the split axis
+     * @return first reference of the second child or begin if the node should become a leaf
+     */
+    size_t partition(size_t depth,
+                     const BoundingBox& bbox,
+                     std::vector<BuildRef>& refs,
+                     size_t begin,
+                     size_t end,
+                     glm::dvec3::length_type& axis) const;
+
+    /**
+     * Split at the median of the triangle centers along a round-robin axis.
+     */
+    size_t partitionMedian(size_t depth,
+                           std::vector<BuildRef>& refs,
+                           size_t begin,
+                           size_t end,
+                           glm::dvec3::length_type& axis) const;
+
+    /**
+     * Split at the bin boundary with the lowest surface area heuristic cost.
+     */
+    size_t partitionSAH(const BoundingBox& bbox,
+                        std::vector<BuildRef>& refs,
+                        size_t begin,
+                        size_t end,
+                        glm::dvec3::length_type& axis) const;
+
+    /**
+     * Collapses the binary subtree into nodes with up to four children and appends them in
+     * depth-first order to nodes_. The triangles of the leaves are appended to packets_.
+     *
+     * @param node root of the subtree
+     * @return index of the subtree root in nodes_
+     */
+    uint32_t flatten(const BuildNode& node);
+
+    /**
+     * Slab test of the ray against the boxes of all children of a node. Performs the operations of
+     * BoundingBox::intersect for all slots at once, i.e. the result is identical to testing the
+     * children one after another.
+     *
+     * @param node the node
+     * @param ray the ray in single precision
+     * @param entry outputs the entry distances of the children
+     * @return bit mask of the entered children
+     */
+    static uint32_t intersectChildren(const WideNode& node,
+                                      const TraversalRay<float>& ray,
+                                      std::array<float, WideNode::width>& entry);
+
+    /**
+     * Pushes the entered children of a node such that the child with the smallest entry distance
+     * is traversed first.
+     *
+     * @param node the node
+     * @param mask bit mask of the entered children
+     * @param entry the entry distances of the children
+     * @param stack the traversal stack
+     * @param stack_size the number of entries on the stack
+     */
+    static void pushChildren(const WideNode& node,
+                             uint32_t mask,
+                             const std::array<float, WideNode::width>& entry,
+                             StackEntry* stack,
+                             size_t& stack_size);
 };
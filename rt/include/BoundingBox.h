@@ -18,6 +18,7 @@
 
 #include "Ray.h"
 #include <glm/glm.hpp>
+#include <limits>
 
 /**
  * This class represents an axis-aligned bounding box.
@@ -49,12 +50,53 @@ struct BoundingBox {
     [[nodiscard]] bool intersect(const BoundingBox& other) const;
 
     /**
-     * Checks if the ray intersects this box in any location.
+     * Checks if the ray intersects this box within the interval [t_min, t_max] of the ray.
      * @param ray the ray
      * @return true if the ray intersects the bbox
      */
     [[nodiscard]] bool intersect(const Ray& ray) const;
 
+    /**
+     * Checks if the ray intersects this box within the interval [t_min, t_max] of the ray and
+     * computes the distance at which the ray enters the box.
+     * @param ray the ray
+     * @param entry entry distance, clamped to t_min if the ray starts inside of the box
+     * @return true if the ray intersects the bbox
+     */
+    [[nodiscard]] bool intersect(const Ray& ray, double& entry) const;
+
+    /**
+     * Slab test of a box given by its corners in the precision of the ray. The sign bits of the
+     * ray select the near and far plane of every slab, hence the test only needs a subtraction
+     * and a multiplication with the reciprocal direction per plane and no division or swap. The
+     * exit distance is enlarged by the accumulated rounding error of the three operations per
+     * slab, hence rays which graze an edge are never culled because of the precision.
+     *
+     * An axis-parallel ray whose origin lies in a plane of the box yields 0 * inf = NaN for that
+     * plane. The comparisons are ordered such that NaN never replaces the current interval, i.e.
+     * the slab is treated as not limiting the ray.
+     *
+     * @param min lower corner of the box
+     * @param max upper corner of the box
+     * @param ray a Ray or a TraversalRay with the precision of the box
+     * @param entry entry distance, clamped to t_min if the ray starts inside of the box
+     * @return true if the ray intersects the box
+     */
+    template <typename T, typename R>
+    [[nodiscard]] static bool
+    intersect(const glm::vec<3, T>& min, const glm::vec<3, T>& max, const R& ray, T& entry);
+
+    /**
+     * Factor which enlarges the exit distance of a slab test in the precision T by the bound of
+     * its relative rounding error, i.e. 1 + 2 * gamma(3) in the notation of pbrt.
+     */
+    template <typename T>
+    constexpr static T slabSlack()
+    {
+        constexpr auto eps = std::numeric_limits<T>::epsilon() / 2;
+        return 1 + 2 * (3 * eps) / (1 - 3 * eps);
+    }
+
     /**
      * Check if the point lies within this bounding box.
      * @param point the point
@@ -70,3 +112,26 @@ struct BoundingBox {
      */
     static BoundingBox unite(const BoundingBox& b1, const BoundingBox& b2);
 };
+
+template <typename T, typename R>
+bool BoundingBox::intersect(const glm::vec<3, T>& min,
+                            const glm::vec<3, T>& max,
+                            const R& ray,
+                            T& entry)
+{
+    constexpr auto slack = slabSlack<T>();
+
+    T t_near = ray.t_min;
+    T t_far = ray.t_max;
+    for (auto a = 0; a < 3; a++) {
+        const auto near_plane = ray.sign[a] ? max[a] : min[a];
+        const auto far_plane = ray.sign[a] ? min[a] : max[a];
+        const auto t0 = (near_plane - ray.nearOrigin()[a]) * ray.inv_dir[a];
+        const auto t1 = (far_plane - ray.farOrigin()[a]) * ray.inv_dir[a] * slack;
+        // written such that a NaN distance keeps the current bound
+        t_near = t0 > t_near ? t0 : t_near;
+        t_far = t1 < t_far ? t1 : t_far;
+    }
+    entry = t_near;
+    return t_near <= t_far;
+}
@@ -16,8 +16,8 @@
 
 #pragma once
 
-#include "RandomUtils.h"
 #include "Ray.h"
+#include "Sampler.h"
 #include <glm/glm.hpp>
 
 /// Represents the camera with information about the 'sensor' size.
@@ -60,9 +60,10 @@ class Camera {
      * Creates a ray that passes through the given pixel position.
      * @param x x-position
      * @param y y-position
+     * @param sampler source of the jitter within the pixel
      * @return randomized ray through this pixel
      */
-    [[nodiscard]] Ray getRay(double x, double y) const;
+    [[nodiscard]] Ray getRay(double x, double y, Sampler& sampler) const;
 
     /**
      * Sets the cameras sensor resolution.
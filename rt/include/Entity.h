@@ -24,36 +24,106 @@
 #include <glm/gtc/epsilon.hpp>
 #include <glm/gtc/matrix_inverse.hpp>
 #include <iostream>
+#include <limits>
 #include <memory>
 #include <utility>
+#include <vector>
 
+class Entity;
 class Material;
+struct RayPacket;
 
+/**
+ * Intersection record. The intersection routines only determine the distance, the primitive and
+ * the barycentric coordinates of the closest hit. The remaining attributes are computed once per
+ * ray by finalize().
+ */
 struct Hit {
+    double t = std::numeric_limits<double>::infinity(); // distance along the ray
+    const Entity* entity = nullptr;                      // the primitive which was hit
+    glm::dvec2 barycentric{};                            // primitive specific surface coordinates
+
     glm::dvec3 normal{};
     glm::dvec3 pos{}; // hit position
     glm::dvec2 uv{};  // uv coordinates of the hit
-    std::shared_ptr<Material> mat;
+    const Material* mat = nullptr; // owned by the scene
     Hit();
+
+    /**
+     * Computes normal, position, uv coordinates and material of the hit.
+     * @param ray the ray which produced the hit
+     */
+    void finalize(const Ray& ray);
 };
 
 class Hittable {
   public:
     virtual ~Hittable() = default;
+
+    /**
+     * Finds the closest intersection within the ray interval. Only t, entity and barycentric of
+     * the hit are set, the hit is left untouched if there is no intersection.
+     */
     [[nodiscard]] virtual bool intersect(const Ray& ray, Hit& hit) const = 0;
+
+    /**
+     * Tests if any surface lies within the ray interval, which is additionally cut off at t_max.
+     * The query stops at the first hit found and computes no hit attributes. The default
+     * implementation falls back to the closest hit query.
+     */
+    [[nodiscard]] virtual bool occluded(const Ray& ray, double t_max) const;
+
+    /**
+     * Finds the closest intersections of the selected rays of a packet. Hits are recorded in the
+     * packet and shrink the interval of their ray, rays without an intersection are left
+     * untouched. The default implementation intersects the rays one after another.
+     *
+     * @param packet the rays and their closest hits so far
+     * @param active mask of the rays which are tested
+     */
+    virtual void intersectPacket(RayPacket& packet, uint64_t active) const;
+
     [[nodiscard]] virtual BoundingBox boundingBox() const = 0;
 };
 
 /// A base class for all entities in the scene.
 class Entity : public Hittable {
   protected:
-    std::shared_ptr<Material> material_;
+    /// Non-owning pointer to the material. The scene keeps the material alive.
+    const Material* material_;
 
   public:
     explicit Entity();
-    explicit Entity(std::shared_ptr<Material> material);
+    explicit Entity(const Material* material);
     ~Entity() override = default;
-    virtual void setMaterial(std::shared_ptr<Material> material);
+    virtual void setMaterial(const Material* material);
+
+    /**
+     * Computes the hit attributes of an intersection with this entity. The default implementation
+     * sets the position and the material.
+     * @param ray the ray which produced the hit
+     * @param hit intersection record produced by intersect()
+     */
+    virtual void finalize(const Ray& ray, Hit& hit) const;
+
+    /**
+     * Returns the surface area of the entity. Entities with an area of zero cannot be sampled and
+     * are not used as light sources.
+     */
+    [[nodiscard]] virtual double area() const { return 0; }
+
+    /**
+     * Samples a point which is uniformly distributed over the surface, i.e. with density 1 / area.
+     * @param u uniformly distributed point in [0,1)^2
+     * @param hit outputs the entity, position, normal, uv coordinates and material of the point
+     */
+    virtual void sample([[maybe_unused]] const glm::dvec2& u, [[maybe_unused]] Hit& hit) const {}
+
+    /**
+     * Appends all primitives of this entity which emit light and can be sampled.
+     * @param lights the list of emitting primitives
+     */
+    virtual void collectLights(std::vector<const Entity*>& lights) const;
 };
 
 class Triangle final : public Entity {
@@ -73,11 +143,42 @@ class Triangle final : public Entity {
 
     Triangle(glm::dvec3 a, glm::dvec3 b, glm::dvec3 c);
     [[nodiscard]] bool intersect(const Ray& ray, Hit& hit) const override;
+    [[nodiscard]] bool occluded(const Ray& ray, double t_max) const override;
+    void finalize(const Ray& ray, Hit& hit) const override;
+    [[nodiscard]] double area() const override;
+    void sample(const glm::dvec2& u, Hit& hit) const override;
     [[nodiscard]] BoundingBox boundingBox() const override;
     [[nodiscard]] glm::dvec3 normal() const;
     [[nodiscard]] glm::dvec2 texMapping(const glm::dvec3& intersect) const;
     void setTexCoords(glm::dvec2 ca, glm::dvec2 cb, glm::dvec2 cc);
     void invalidate();
+
+    /**
+     * Moeller-Trumbore intersection of a triangle given by a corner and the two edges starting
+     * there. Acceleration structures call it with their own compact copy of the triangles.
+     * @param a first corner
+     * @param ab edge from the first to the second corner
+     * @param ac edge from the first to the third corner
+     * @param ray the ray
+     * @param t_max end of the interval, which starts at ray.t_min
+     * @param t outputs the distance of the intersection
+     * @param barycentric outputs the coordinates of the intersection in the basis ab, ac
+     * @return true if the ray hits the triangle within the interval
+     */
+    static bool intersect(const glm::dvec3& a,
+                          const glm::dvec3& ab,
+                          const glm::dvec3& ac,
+                          const Ray& ray,
+                          double t_max,
+                          double& t,
+                          glm::dvec2& barycentric);
+
+  private:
+    /**
+     * Computes the distance and the barycentric coordinates of the intersection within the
+     * interval (ray.t_min, t_max).
+     */
+    bool intersect(const Ray& ray, double t_max, double& t, glm::dvec2& barycentric) const;
 };
 
 class Sphere final : public Entity {
@@ -88,8 +189,17 @@ class Sphere final : public Entity {
     Sphere();
     Sphere(glm::dvec3 center, double radius);
     [[nodiscard]] bool intersect(const Ray& ray, Hit& hit) const override;
+    [[nodiscard]] bool occluded(const Ray& ray, double t_max) const override;
+    void finalize(const Ray& ray, Hit& hit) const override;
+    [[nodiscard]] double area() const override;
+    void sample(const glm::dvec2& u, Hit& hit) const override;
     [[nodiscard]] BoundingBox boundingBox() const override;
 
   private:
+    /**
+     * Computes the distance of the closest intersection within the interval (ray.t_min, t_max).
+     */
+    bool intersect(const Ray& ray, double t_max, double& t) const;
+
     [[nodiscard]] glm::dvec2 texMapping(const glm::dvec3& intersect) const;
 };
@@ -28,10 +28,14 @@
 struct ExplicitEntity final : Entity {
     explicit ExplicitEntity(std::vector<Triangle> faces);
 
-    void setMaterial(std::shared_ptr<Material> material) override;
+    void setMaterial(const Material* material) override;
+
+    void collectLights(std::vector<const Entity*>& lights) const override;
 
     [[nodiscard]] bool intersect(const Ray& ray, Hit& hit) const override;
 
+    [[nodiscard]] bool occluded(const Ray& ray, double t_max) const override;
+
     [[nodiscard]] BoundingBox boundingBox() const override;
 
   private:
@@ -19,9 +19,12 @@
 #include <QImage>
 
 #include <glm/glm.hpp>
+#include <string>
 
 /**
- * Wrapper class for a QImage.
+ * Wrapper class for a QImage. It is not thread-safe: the QImage shares its pixels with its copies
+ * and detaches on the first write, hence concurrent writes, or a write concurrent to a copy, must
+ * be serialized by the owner.
  */
 class Image {
     QImage _image;
@@ -62,11 +65,23 @@ class Image {
      */
     [[nodiscard]] glm::dvec3 getPixel(int x, int y) const;
 
+    /**
+     * Creates a copy which does not share its pixels with this image.
+     */
+    [[nodiscard]] Image copy() const;
+
     /**
      * Sets all image pixels to black.
      */
     void clear();
 
+    /**
+     * Writes the image to a file. The format is deduced from the file extension.
+     * @param file output file name
+     * @return true if the image was written successfully
+     */
+    [[nodiscard]] bool save(const std::string& file) const;
+
   private:
     friend class Viewer;
 };
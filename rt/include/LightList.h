@@ -0,0 +1,73 @@
+/**
+ *    Copyright 2020 Jannik Bamberger
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include "Entity.h"
+#include <glm/glm.hpp>
+#include <unordered_map>
+#include <vector>
+
+/**
+ * Point on a light source which was sampled for direct lighting.
+ */
+struct LightSample {
+    /// the point with position, normal, uv coordinates, material and the emitting primitive
+    Hit hit;
+    /// density of the point with respect to area, includes the selection of the primitive
+    double pdf = 0;
+};
+
+/**
+ * The emitting primitives of a scene. A primitive is selected with a probability proportional to
+ * its power, afterwards a point is chosen uniformly on its surface.
+ */
+class LightList {
+    std::vector<const Entity*> lights_;
+    /// cumulative selection probabilities of the lights
+    std::vector<double> cdf_;
+    /// selection probability of every light
+    std::unordered_map<const Entity*, double> selection_;
+
+  public:
+    LightList() = default;
+
+    /**
+     * Creates the list from the given primitives. The power of a primitive is estimated from its
+     * area and the emission at the center of its parameter domain.
+     * @param lights emitting primitives with a non-zero area
+     */
+    explicit LightList(std::vector<const Entity*> lights);
+
+    [[nodiscard]] bool empty() const;
+    [[nodiscard]] size_t size() const;
+
+    /**
+     * Samples a point on one of the lights. The list must not be empty.
+     * @param u_select uniformly distributed number in [0,1) which selects the light
+     * @param u_point uniformly distributed point in [0,1)^2 which selects the point on the light
+     * @return the sampled point
+     */
+    [[nodiscard]] LightSample sample(double u_select, const glm::dvec2& u_point) const;
+
+    /**
+     * Returns the density with respect to area with which sample() generates a point on the given
+     * primitive.
+     * @param light the primitive
+     * @return the density, 0 if the primitive is not part of the list
+     */
+    [[nodiscard]] double pdf(const Entity* light) const;
+};
@@ -18,29 +18,78 @@
 
 #include "Entity.h"
 #include "Ray.h"
+#include "Sampler.h"
 #include "Texture.h"
 #include <glm/glm.hpp>
 
+/**
+ * \brief Result of sampling a scattered direction.
+ */
+struct ScatterRecord {
+    /// the scattered ray
+    Ray ray;
+    /// value of the BSDF for the incoming and the scattered direction
+    glm::dvec3 bsdf{0, 0, 0};
+    /// probability density of the scattered direction with respect to solid angle
+    double pdf = 0;
+    /// bsdf * |cos| / pdf, the damping of the light transport along the scattered ray
+    glm::dvec3 attenuation{0, 0, 0};
+    /// The direction was drawn from a distribution without a usable density, e.g. a mirror. Then
+    /// only the attenuation is valid and evaluate() / pdf() cannot reproduce the sample.
+    bool specular = false;
+};
+
 /**
  * \brief Abstract base class for all materials.
  * The class describes the light emitted as well as the scattering behavior of the material.
+ *
+ * Directions follow the light transport: wi is the direction of the incoming ray, i.e. it points
+ * towards the surface, and wo points away from the surface along the scattered ray.
  */
 class Material {
   public:
     virtual ~Material() = default;
 
     /**
-     * \brief Computes a new scattered ray given an input and hit.
+     * \brief Samples a scattered direction given an input and hit.
      * \param in The incoming ray that hit the material
      * \param ir intersection record describing the hit properties
-     * \param attenuation outputs the damping of the light transport for the scattered ray
-     * \param scatter_ray the new scattered ray
+     * \param sampler source of the random decisions
+     * \param rec outputs the scattered ray with its BSDF value and density
      * \return true if there is a scattered ray
      */
     virtual bool scatter(const Ray& in,
                          const Hit& ir,
-                         glm::dvec3& attenuation,
-                         Ray& scatter_ray) const = 0;
+                         Sampler& sampler,
+                         ScatterRecord& rec) const = 0;
+
+    /**
+     * \brief Evaluates the non-specular part of the BSDF.
+     * \param ir intersection record describing the hit properties
+     * \param wi normalized direction of the incoming ray
+     * \param wo normalized scattered direction
+     * \return the BSDF value per channel
+     */
+    [[nodiscard]] virtual glm::dvec3 evaluate([[maybe_unused]] const Hit& ir,
+                                              [[maybe_unused]] const glm::dvec3& wi,
+                                              [[maybe_unused]] const glm::dvec3& wo) const
+    {
+        return glm::dvec3(0, 0, 0);
+    }
+
+    /**
+     * \brief Returns the density with which scatter() samples the direction wo.
+     * \param ir intersection record describing the hit properties
+     * \param wi normalized direction of the incoming ray
+     * \param wo normalized scattered direction
+     * \return the density with respect to solid angle
+     */
+    [[nodiscard]] virtual double pdf([[maybe_unused]] const Hit& ir,
+                                     [[maybe_unused]] const glm::dvec3& wi,
+                                     [[maybe_unused]] const glm::dvec3& wo) const
+    {
+        return 0;
+    }
 
     /**
      * \brief Returns the emission of the given material
@@ -51,12 +100,18 @@ class Material {
     {
         return glm::dvec3(0, 0, 0);
     }
+
+    /**
+     * \brief Returns true if the material emits light, i.e. emission() is not zero everywhere.
+     */
+    [[nodiscard]] virtual bool isEmissive() const { return false; }
 };
 
 /**
  * \brief Material that has Lambertian scattering properties.
  *
- * The material scatters the rays into the hemisphere uniformly.
+ * The material reflects the light uniformly into the hemisphere of the incoming ray. The directions
+ * are importance sampled with a cosine distribution.
  */
 class LambertianMaterial : public Material {
   protected:
@@ -65,10 +120,13 @@ class LambertianMaterial : public Material {
   public:
     explicit LambertianMaterial(const glm::dvec3& color);
     explicit LambertianMaterial(std::shared_ptr<Texture> tex);
-    bool scatter(const Ray& in,
-                 const Hit& ir,
-                 glm::dvec3& attenuation,
-                 Ray& scatter_ray) const override;
+    bool scatter(const Ray& in, const Hit& ir, Sampler& sampler, ScatterRecord& rec) const override;
+    [[nodiscard]] glm::dvec3 evaluate(const Hit& ir,
+                                      const glm::dvec3& wi,
+                                      const glm::dvec3& wo) const override;
+    [[nodiscard]] double pdf(const Hit& ir,
+                             const glm::dvec3& wi,
+                             const glm::dvec3& wo) const override;
 };
 
 /**
@@ -80,13 +138,14 @@ class DiffuseLight final : public LambertianMaterial {
     explicit DiffuseLight(const glm::dvec3& color);
     explicit DiffuseLight(std::shared_ptr<Texture> tex);
     [[nodiscard]] glm::dvec3 emission(const glm::dvec2& uv) const override;
+    [[nodiscard]] bool isEmissive() const override;
 };
 
 /**
  * \brief This material has properties similar to a metal.
  *
  * The material acts as a reflector for low values of spec_size_ and more like a diffuse object for
- * high values.
+ * high values. The offset reflection has no closed-form density, hence it is treated as specular.
  */
 class MetalLikeMaterial final : public Material {
     glm::dvec3 attenuation_;
@@ -94,10 +153,7 @@ class MetalLikeMaterial final : public Material {
 
   public:
     MetalLikeMaterial(const glm::dvec3& attenuation, double spec_size);
-    bool scatter(const Ray& in,
-                 const Hit& ir,
-                 glm::dvec3& attenuation,
-                 Ray& scatter_ray) const override;
+    bool scatter(const Ray& in, const Hit& ir, Sampler& sampler, ScatterRecord& rec) const override;
 };
 
 /**
@@ -111,10 +167,7 @@ class Dielectric final : public Material {
 
   public:
     explicit Dielectric(double refractive_index);
-    bool scatter(const Ray& in,
-                 const Hit& ir,
-                 glm::dvec3& attenuation,
-                 Ray& scatter_ray) const override;
+    bool scatter(const Ray& in, const Hit& ir, Sampler& sampler, ScatterRecord& rec) const override;
 
   private:
     /**
@@ -37,6 +37,8 @@ class Octree : public Hittable {
      */
     Octree(glm::dvec3 min, glm::dvec3 max);
 
+    ~Octree() override;
+
     /**
      * Store an entity in the correct position of the octree.
      *
@@ -54,6 +56,26 @@ class Octree : public Hittable {
      */
     [[nodiscard]] bool intersect(const Ray& ray, Hit& hit) const override;
 
+    /**
+     * Tests if any entity in the tree intersects the ray before t_max. The search stops at the
+     * first intersection, which makes it cheaper than intersect() for shadow rays.
+     *
+     * @param ray intersecting ray
+     * @param t_max end of the tested interval along the ray
+     * @return true if an intersection exists
+     */
+    [[nodiscard]] bool occluded(const Ray& ray, double t_max) const override;
+
+    /**
+     * Finds the closest intersections of the selected rays of a packet. The rays traverse the
+     * tree together, a node is only tested ray by ray if the interval bounds of the rays may
+     * enter it.
+     *
+     * @param packet the rays and their closest hits so far
+     * @param active mask of the rays which are tested
+     */
+    void intersectPacket(RayPacket& packet, uint64_t active) const override;
+
     /**
      * Returns the bounding box spanning the entire tree.
      *
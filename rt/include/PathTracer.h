@@ -16,51 +16,318 @@
 
 #pragma once
 
+#include <atomic>
+#include <cstdint>
+#include <limits>
 #include <memory>
+#include <mutex>
 #include <random>
+#include <vector>
 
 #include <glm/glm.hpp>
 #include <glm/gtx/string_cast.hpp>
 
 #include "Camera.h"
 #include "Image.h"
+#include "LightList.h"
 #include "Octree.h"
+#include "RenderStats.h"
+#include "Sampler.h"
 
 class PathTracer {
-    bool running_ = false;
+    /// Edge length of the square screen tiles which are distributed to the worker threads.
+    constexpr static int tile_size_ = 32;
+
+    /// Edge length of the pixel blocks whose primary rays are traced as one packet.
+    constexpr static int packet_size_ = 8;
+
+    /// Upper limit of samples per pixel a tile accumulates before it is published to the image.
+    constexpr static size_t max_pass_samples_ = 32;
+
+    /// Factor by which the adaptive sampling may exceed the sample count in noisy pixels.
+    constexpr static size_t adaptive_max_factor_ = 8;
+
+    /// Upper limit of samples per pixel if the frame is limited by time or error instead.
+    constexpr static size_t max_open_samples_ = 1 << 16;
+
+    /// Rectangular region of the image [x0, x1) x [y0, y1).
+    struct Tile {
+        int x0, y0, x1, y1;
+    };
+
+    /// Per-pixel sample statistics of a frame.
+    struct Accumulator {
+        /// sum of the sampled colors
+        std::vector<glm::dvec3> sum;
+        /// sum of the squared luminances of the samples, used for the variance estimate
+        std::vector<double> sum_sq;
+        /// number of samples of each pixel
+        std::vector<uint32_t> count;
+        /// pixels which receive samples in the next pass
+        std::vector<uint8_t> active;
+
+        explicit Accumulator(size_t pixels = 0);
+    };
+
+    std::atomic_bool running_{false};
     size_t samples_;
+    int threads_ = 0;
+    /// number of bounces before the russian roulette may terminate a path
+    int min_bounces_ = 3;
+    /// hard limit of the bounces per path
+    int max_bounces_ = 64;
+    SamplerType sampler_type_ = SamplerType::Sobol;
+    /// relative error below which a pixel is converged, 0 disables the adaptive sampling
+    double adaptive_threshold_ = 0.0;
+    /// samples every pixel receives before its error estimate is trusted
+    size_t adaptive_min_samples_ = 16;
+    /// wall-clock limit of a frame in seconds, 0 disables the limit
+    double time_budget_ = 0.0;
+    /// estimated relative error at which a frame is finished, 0 disables the target
+    double error_target_ = 0.0;
+    /// trace the primary rays of a pixel block as one packet
+    bool packets_ = true;
+    bool seeded_ = false;
+    uint64_t seed_ = 0;
+    /// Seed of the current frame. Equals seed_ if set, otherwise it is taken from the clock.
+    uint64_t frame_seed_ = 0;
     Camera camera_;
     std::shared_ptr<const Octree> scene_;
+    std::shared_ptr<const LightList> lights_;
+    /// Dimensions of the current frame
+    int width_ = 0;
+    int height_ = 0;
+    /// Written by the workers one tile at a time and copied for the viewer, both guarded by
+    /// image_mutex_.
     std::shared_ptr<Image> image_;
+    mutable std::mutex image_mutex_;
+    Accumulator accumulator_;
+
+    /// Counters of the current frame. The thread-local counters are merged after every tile.
+    mutable std::mutex stats_mutex_;
+    mutable RenderStats stats_;
+
+  public:
+    /// State of the current or last frame after the last finished pass.
+    struct Progress {
+        /// average number of samples per pixel
+        double samples_per_pixel = 0.0;
+        /// mean of the relative standard errors of the pixel luminances
+        double error = std::numeric_limits<double>::infinity();
+        /// render time of the frame
+        double seconds = 0.0;
+    };
+
+  private:
+    /// Guarded by stats_mutex_.
+    Progress progress_;
 
   public:
     PathTracer() = delete;
     explicit PathTracer(const Camera& camera, std::shared_ptr<const Octree> scene);
 
     void setScene(std::shared_ptr<const Octree> scene);
+
+    /**
+     * Sets the light sources which are sampled directly at every diffuse bounce. Without lights
+     * the paths only find light sources by chance.
+     * @param lights emitting primitives of the scene
+     */
+    void setLights(std::shared_ptr<const LightList> lights);
     void setSampleCount(size_t samples);
+
+    /**
+     * Sets the number of worker threads used by run. A value of 0 uses the OpenMP default.
+     * @param threads number of threads
+     */
+    void setThreadCount(int threads);
+
+    /**
+     * Sets the path length limits. After min_bounces every path survives a bounce with a
+     * probability proportional to its throughput (russian roulette), the surviving paths are
+     * weighted up, which keeps the estimate unbiased. Paths are cut off at max_bounces.
+     * @param min_bounces bounces which are always traced
+     * @param max_bounces maximum number of bounces
+     */
+    void setBounceLimits(int min_bounces, int max_bounces);
+
+    /**
+     * Enables the adaptive sampling. The sample count then sets the average budget per pixel.
+     * Pixels stop receiving samples once the standard error of their luminance, relative to the
+     * luminance, drops below the threshold in their whole 3x3 neighbourhood. The saved samples
+     * are spent on the remaining noisy pixels, up to adaptive_max_factor_ times the sample count.
+     * @param threshold relative error target, 0 disables the adaptive sampling
+     * @param min_samples samples per pixel before a pixel may converge
+     */
+    void setAdaptive(double threshold, size_t min_samples = 16);
+
+    /**
+     * Limits the wall-clock time of a frame. Instead of a fixed sample count the frame receives
+     * passes until the next pass would exceed the budget. The pass sizes are predicted from the
+     * time per sample of the previous pass, hence the frame always ends at a sample boundary.
+     * @param seconds time budget, 0 renders the fixed sample count
+     */
+    void setTimeBudget(double seconds);
+
+    /**
+     * Renders a frame until the estimated relative error, as reported by getProgress, drops below
+     * the target. The target can be combined with a time budget, whichever is reached first ends
+     * the frame.
+     * @param error relative error target, 0 renders the fixed sample count
+     */
+    void setErrorTarget(double error);
+
+    /**
+     * Enables the packet tracing of the primary rays. The primary rays of a block of
+     * packet_size_ x packet_size_ pixels share the traversal of the scene, the bounces are traced
+     * ray by ray. The image is the same as with single rays, only hits at exactly the same
+     * distance may be resolved differently.
+     * @param enabled true to trace the primary rays in packets
+     */
+    void setPacketTracing(bool enabled);
+
+    /**
+     * Selects the sampler which generates the random decisions of the paths.
+     * @param type the sampler implementation
+     */
+    void setSampler(SamplerType type);
+
+    /**
+     * Makes the rendering reproducible. The sample values of every path only depend on the seed,
+     * the pixel and the sample index. Hence the image is bit-identical for any number of
+     * threads and any scheduling of the tiles.
+     * @param seed the seed of the frame
+     */
+    void setSeed(uint64_t seed);
+
+    /**
+     * Renders the scene into a new image of the given size. The image is split into tiles which
+     * are processed in parallel. Each tile accumulates a batch of samples in a private buffer and
+     * adds it to its own pixels of the accumulator without a lock. The tile is then published to
+     * the image under image_mutex_. The batches grow with every pass, so that a preview is
+     * available quickly.
+     * @param w image width
+     * @param h image height
+     */
     void run(int w, int h);
     [[nodiscard]] bool running() const;
     void stop();
     void start();
 
+    /**
+     * Returns a snapshot of the current or last frame. It is a deep copy, hence it may be kept
+     * while the rendering continues.
+     * @return copy of the image
+     */
     [[nodiscard]] std::shared_ptr<Image> getImage() const;
 
+    /**
+     * Returns the counters of the current or last frame. The counters cover all finished tiles.
+     * @return copy of the frame counters
+     */
+    [[nodiscard]] RenderStats getStats() const;
+
+    /**
+     * Returns the achieved samples per pixel, the error estimate and the time of the current or
+     * last frame. The values are updated after every pass.
+     * @return copy of the frame progress
+     */
+    [[nodiscard]] Progress getProgress() const;
+
+    /**
+     * Creates a diagnostic image of the number of samples per pixel. The colors run from black
+     * (no samples) over red and yellow to white (most samples of the frame).
+     * @return heatmap of the sample counts of the last frame
+     */
+    [[nodiscard]] std::shared_ptr<Image> getSampleHeatmap() const;
+
   private:
     /**
-     * Iterative implementation of the path tracing.
+     * Returns the number of threads used for rendering.
+     */
+    [[nodiscard]] int threadCount() const;
+
+    /**
+     * Splits the image into tiles of at most tile_size_ x tile_size_ pixels.
+     */
+    [[nodiscard]] static std::vector<Tile> makeTiles(int w, int h);
+
+    /**
+     * Estimates the relative standard error of the mean luminance of every pixel. Pixels with
+     * less than two samples have an infinite error.
+     */
+    [[nodiscard]] std::vector<double> pixelErrors() const;
+
+    /**
+     * Deactivates the pixels whose error and the error of all their neighbours is below the
+     * adaptive threshold.
+     * @param error the per-pixel errors as returned by pixelErrors
+     * @return number of pixels which remain active
+     */
+    size_t updateActivePixels(int w, int h, const std::vector<double>& error);
+
+    /**
+     * Traces the given number of samples for every active pixel of the tile. The samples are
+     * gathered in a tile-local buffer and afterwards added to the accumulator and written to the
+     * image. Tiles never overlap, hence no synchronization between the threads is necessary.
+     * With packet tracing the tile is processed in blocks, one sample of the whole block at a
+     * time.
+     *
+     * @param tile the processed region
+     * @param samples number of samples per pixel in this pass
+     * @param total number of samples per active pixel after this pass
+     * @return false if the rendering was stopped before the tile was finished
+     */
+    bool renderTile(const Tile& tile, size_t samples, size_t total);
+
+    /**
+     * Iterative implementation of the path tracing. Every non-specular bounce samples a point on a
+     * light source (next-event estimation). The direct light and the light found by the scattered
+     * ray are combined with multiple importance sampling.
      *
      * @param x x coordinate of the current pixel
      * @param y y coordinate of the current pixel
+     * @param sampler source of the random decisions, prepared for the current sample
+     * @return the light intensity transported on the traced path
+     */
+    [[nodiscard]] glm::dvec3 computePixel(int x, int y, Sampler& sampler) const;
+
+    /**
+     * Continues the path of computePixel after the closest hit of the primary ray is known.
+     *
+     * @param ray the primary ray
+     * @param hit the closest hit of the primary ray, not finalized
+     * @param found false if the primary ray hit nothing
+     * @param sampler source of the random decisions, the camera sample is already drawn
      * @return the light intensity transported on the traced path
      */
-    [[nodiscard]] glm::dvec3 computePixel(int x, int y) const;
+    [[nodiscard]] glm::dvec3 tracePath(Ray ray, Hit hit, bool found, Sampler& sampler) const;
+
+    /**
+     * Estimates the light which arrives directly from a sampled point on a light source and is
+     * scattered along the incoming ray. The estimate is weighted with the power heuristic against
+     * the sampling of the BSDF.
+     *
+     * @param ray the incoming ray
+     * @param hit the finalized hit of the ray
+     * @param sampler source of the random decisions
+     * @return the scattered direct light
+     */
+    [[nodiscard]] glm::dvec3 sampleLight(const Ray& ray, const Hit& hit, Sampler& sampler) const;
+
+    /**
+     * Multiple importance sampling weight of a sample drawn with density pdf_a which could also
+     * have been drawn by a strategy with density pdf_b.
+     */
+    [[nodiscard]] static double powerHeuristic(double pdf_a, double pdf_b);
 
     /**
-     * Recursive implementation of the path tracing.
+     * Recursive implementation of the path tracing. It only samples the BSDF and does not use the
+     * light sources directly.
      *
      * @param ray input ray
+     * @param sampler source of the random decisions, prepared for the current sample
      * @return The light intensity transported on the traced path
      */
-    [[nodiscard]] glm::dvec3 computePixel(const Ray& ray) const;
+    [[nodiscard]] glm::dvec3 computePixel(const Ray& ray, Sampler& sampler) const;
 };
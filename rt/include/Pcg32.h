@@ -0,0 +1,79 @@
+/**
+ *    Copyright 2020 Jannik Bamberger
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+
+/**
+ * Permuted congruential generator with 64 bit state and 32 bit output (PCG-XSH-RR) by Melissa
+ * O'Neill. The generator is small, fast and passes the common statistical test suites. Different
+ * streams produce independent sequences for the same seed.
+ */
+class Pcg32 {
+    constexpr static uint64_t multiplier_ = 6364136223846793005ULL;
+    constexpr static uint64_t default_state_ = 0x853c49e6748fea9bULL;
+    constexpr static uint64_t default_stream_ = 0xda3e39cb94b95bdbULL;
+
+    uint64_t state_ = 0;
+    uint64_t inc_ = 0;
+
+  public:
+    explicit Pcg32(uint64_t seed = default_state_, uint64_t stream = default_stream_)
+    {
+        this->seed(seed, stream);
+    }
+
+    /**
+     * Restarts the generator.
+     * @param seed starting state
+     * @param stream sequence selector, only the lower 63 bits are used
+     */
+    void seed(uint64_t seed, uint64_t stream = default_stream_)
+    {
+        state_ = 0;
+        inc_ = (stream << 1U) | 1U;
+        nextUInt();
+        state_ += seed;
+        nextUInt();
+    }
+
+    /**
+     * Returns a uniformly distributed 32 bit number.
+     */
+    uint32_t nextUInt()
+    {
+        const auto old = state_;
+        state_ = old * multiplier_ + inc_;
+        const auto xorshifted = static_cast<uint32_t>(((old >> 18U) ^ old) >> 27U);
+        const auto rot = static_cast<uint32_t>(old >> 59U);
+        return (xorshifted >> rot) | (xorshifted << ((~rot + 1U) & 31U));
+    }
+
+    /**
+     * Returns a uniformly distributed number in [0, 1). The 32 random bits are placed in the
+     * mantissa of a double in [1, 2), which avoids the integer to floating point conversion and
+     * the division.
+     */
+    double nextDouble()
+    {
+        const auto bits = (static_cast<uint64_t>(nextUInt()) << 20U) | 0x3ff0000000000000ULL;
+        double value;
+        std::memcpy(&value, &bits, sizeof(value));
+        return value - 1.0;
+    }
+};
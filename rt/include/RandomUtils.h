@@ -16,30 +16,67 @@
 
 #pragma once
 
+#include "Pcg32.h"
 #include <chrono>
+#include <cstdint>
 #include <glm/glm.hpp>
 #include <glm/gtc/constants.hpp>
-#include <random>
 
 /**
- * Returns a random number between 0 and 1. The number is generated from a thread-local rng.
- * @return random number in the interval [0,1]
+ * Returns the random engine of the calling thread. It is seeded from the clock unless seedRng()
+ * is called.
  */
-inline double rng()
+inline Pcg32& rngEngine()
 {
-    static thread_local std::default_random_engine engine(
-        static_cast<unsigned int>(std::chrono::system_clock::now().time_since_epoch().count()));
+    static thread_local Pcg32 engine(
+        static_cast<uint64_t>(std::chrono::system_clock::now().time_since_epoch().count()),
+        reinterpret_cast<uintptr_t>(&engine)); // the address differs per thread
+    return engine;
+}
 
-    std::uniform_real_distribution<double> dist(0, 1);
-    return dist(engine);
+/**
+ * Scrambles the bits of the value with the splitmix64 finalizer, such that consecutive inputs
+ * produce unrelated outputs.
+ */
+inline uint64_t mixBits(uint64_t value)
+{
+    value += 0x9E3779B97F4A7C15ULL;
+    value = (value ^ (value >> 30U)) * 0xBF58476D1CE4E5B9ULL;
+    value = (value ^ (value >> 27U)) * 0x94D049BB133111EBULL;
+    return value ^ (value >> 31U);
 }
 
 /**
- * Computes a random point in the unit sphere. The point is computed directly.
+ * Reseeds the random engine of the calling thread. The seed is scrambled first, such that
+ * consecutive seeds produce unrelated sequences.
+ * @param seed the new seed
+ */
+inline void seedRng(uint64_t seed) { rngEngine().seed(mixBits(seed), seed); }
+
+/**
+ * Returns a random number between 0 and 1. The number is generated from a thread-local rng.
+ * @return random number in the interval [0,1)
+ */
+inline double rng() { return rngEngine().nextDouble(); }
+
+/**
+ * Returns two independent random numbers between 0 and 1 from the thread-local rng.
+ * @return random numbers in the interval [0,1)
+ */
+inline glm::dvec2 rng2()
+{
+    auto& engine = rngEngine();
+    const auto r1 = engine.nextDouble();
+    return {r1, engine.nextDouble()};
+}
+
+/**
+ * Maps a point of the unit square to a point in the unit sphere. The point is computed directly.
  *
- * @return random point in the unit sphere.
+ * @param r uniformly distributed point in [0,1)^2
+ * @return point in the unit sphere.
  */
-inline glm::dvec3 randomOffset()
+inline glm::dvec3 randomOffset(const glm::dvec2& r)
 {
     //    glm::dvec3 p;
     //    do {
@@ -48,8 +85,8 @@ inline glm::dvec3 randomOffset()
     //    return p;
 
     glm::dvec3 vec;
-    auto r1 = rng();
-    auto r2 = rng();
+    const auto r1 = r.x;
+    const auto r2 = r.y;
     vec.x = glm::cos(glm::two_pi<double>() * r1) * 2 * glm::sqrt(r2 * (1 - r2));
     vec.y = glm::sin(glm::two_pi<double>() * r1) * 2 * glm::sqrt(r2 * (1 - r2));
     vec.z = 1 - 2 * r2;
@@ -57,18 +94,28 @@ inline glm::dvec3 randomOffset()
 }
 
 /**
- * Compute a random point in the hemisphere given by the normal vector and the incoming ray
- * direction.
+ * Computes a random point in the unit sphere. The point is computed directly.
+ *
+ * @return random point in the unit sphere.
+ */
+inline glm::dvec3 randomOffset() { return randomOffset(rng2()); }
+
+/**
+ * Maps a point of the unit square to a direction in the hemisphere given by the normal vector and
+ * the incoming ray direction. The directions are cosine-distributed around the normal, i.e. the
+ * density is cos(theta) / pi.
  *
  * @param normal surface normal
  * @param direction ray direction
- * @return random point in the hemisphere
+ * @param r uniformly distributed point in [0,1)^2
+ * @return direction in the hemisphere
  */
-inline glm::dvec3 hemisphere(const glm::dvec3 normal, const glm::dvec3 direction)
+inline glm::dvec3 hemisphere(const glm::dvec3 normal,
+                             const glm::dvec3 direction,
+                             const glm::dvec2& r)
 {
-
-    const auto r1 = glm::two_pi<double>() * rng();
-    const auto r2 = rng();
+    const auto r1 = glm::two_pi<double>() * r.x;
+    const auto r2 = r.y;
     const auto sq2 = glm::sqrt(r2);
 
     const auto x = glm::cos(r1) * sq2;
@@ -85,9 +132,22 @@ inline glm::dvec3 hemisphere(const glm::dvec3 normal, const glm::dvec3 direction
     } else {
         c = glm::dvec3(0, 0, 1);
     }
-    const auto u = glm::cross(c, w);
+    const auto u = glm::normalize(glm::cross(c, w));
     const auto v = glm::cross(w, u);
 
     // shirley 14. Sampling p294 short form which avoid duplicate use of trig function
     return glm::normalize(u * x + v * y + w * z);
 }
+
+/**
+ * Compute a random point in the hemisphere given by the normal vector and the incoming ray
+ * direction.
+ *
+ * @param normal surface normal
+ * @param direction ray direction
+ * @return random point in the hemisphere
+ */
+inline glm::dvec3 hemisphere(const glm::dvec3 normal, const glm::dvec3 direction)
+{
+    return hemisphere(normal, direction, rng2());
+}
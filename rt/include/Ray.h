@@ -16,7 +16,11 @@
 
 #pragma once
 
+#include <array>
+#include <cmath>
+#include <cstdint>
 #include <glm/glm.hpp>
+#include <limits>
 
 struct Ray {
     constexpr static auto offset = 1e-7;
@@ -24,15 +28,30 @@ struct Ray {
     /// The origination point of the ray.
     glm::dvec3 origin;
 
-    /// Normalized directional vector.
+    /// Normalized directional vector. It must not be changed after the construction, because the
+    /// reciprocal and the sign bits are derived from it.
     glm::dvec3 dir;
 
+    /// Component-wise reciprocal of dir. Axis-parallel directions have infinite components.
+    glm::dvec3 inv_dir;
+
+    /// Per axis 1 if the direction is negative (including -0), which selects the slab plane the
+    /// ray enters first.
+    std::array<uint8_t, 3> sign;
+
     /// The number of predecessor rays, i.e. 0 = primary, 1 = secondary, 2 = ternary, ...
     size_t child_level;
 
     /// The material density where the ray originates.
     double refractive_index;
 
+    /// Start of the valid interval along the ray. Intersections must lie beyond this distance.
+    double t_min = 0;
+
+    /// End of the valid interval along the ray. Intersection routines only report hits closer
+    /// than this distance. Acceleration structures shrink it to the closest hit found so far.
+    double t_max = std::numeric_limits<double>::infinity();
+
     /// Creates a new ray but adopts the parent rays properties.
     explicit Ray(const glm::dvec3 origin = glm::dvec3(0, 0, 0),
                  const glm::dvec3 dir = glm::dvec3(1, 0, 0),
@@ -41,6 +60,10 @@ struct Ray {
         : origin(origin), dir(glm::normalize(dir)), child_level(child_level),
           refractive_index(refractive_index)
     {
+        inv_dir = 1.0 / this->dir;
+        for (auto a = 0; a < 3; a++) {
+            sign[a] = std::signbit(this->dir[a]) ? 1 : 0;
+        }
     }
 
     /// Creates a new ray which is offset a tiny bit in the direction of the ray. This avoids
@@ -50,4 +73,71 @@ struct Ray {
     {
         return Ray(o + d * offset, d, child_level + 1, refractive_index);
     }
+
+    /// Origin used for the distances of the slab planes which the ray enters. In double precision
+    /// it is the origin itself, see TraversalRay.
+    [[nodiscard]] const glm::dvec3& nearOrigin() const { return origin; }
+
+    /// Origin used for the distances of the slab planes which the ray leaves.
+    [[nodiscard]] const glm::dvec3& farOrigin() const { return origin; }
+};
+
+/**
+ * Copy of a ray in the precision of a traversal kernel. Acceleration structures test their nodes
+ * against it, the primitives are still intersected with the double precision ray. A float copy
+ * halves the size of the operands of the box tests. The conversion rounds the interval outwards,
+ * such that the narrower type never culls a box which the double precision ray would enter.
+ *
+ * The slack of the box test only covers the rounding of its own operations. Far from the world
+ * origin the conversion error of the origin exceeds it, hence the origin is rounded twice: towards
+ * the entry planes for their distances and away from the exit planes for theirs. Both distances
+ * then bound the exact ones before the arithmetic error.
+ */
+template <typename T>
+struct TraversalRay {
+    /// Origin rounded such that the distances of the entry planes are not overestimated
+    glm::vec<3, T> near_origin;
+    /// Origin rounded such that the distances of the exit planes are not underestimated
+    glm::vec<3, T> far_origin;
+    glm::vec<3, T> inv_dir;
+    std::array<uint8_t, 3> sign;
+    T t_min;
+    T t_max;
+
+    /// Leaves the members uninitialized, e.g. for the per-ray copies of a packet.
+    TraversalRay() = default;
+
+    explicit TraversalRay(const Ray& ray)
+        : inv_dir(ray.inv_dir), sign(ray.sign), t_min(roundDown(ray.t_min)),
+          t_max(roundUp(ray.t_max))
+    {
+        for (auto a = 0; a < 3; a++) {
+            // a larger origin shortens the distances along a positive direction
+            const auto down = roundDown(ray.origin[a]);
+            const auto up = roundUp(ray.origin[a]);
+            near_origin[a] = sign[a] ? down : up;
+            far_origin[a] = sign[a] ? up : down;
+        }
+    }
+
+    [[nodiscard]] const glm::vec<3, T>& nearOrigin() const { return near_origin; }
+
+    [[nodiscard]] const glm::vec<3, T>& farOrigin() const { return far_origin; }
+
+    /// Shrinks the interval to a hit of the double precision ray.
+    void setMax(const double t) { t_max = roundUp(t); }
+
+    static T roundDown(const double value)
+    {
+        const auto rounded = static_cast<T>(value);
+        return rounded > value ? std::nextafter(rounded, -std::numeric_limits<T>::infinity())
+                               : rounded;
+    }
+
+    static T roundUp(const double value)
+    {
+        const auto rounded = static_cast<T>(value);
+        return rounded < value ? std::nextafter(rounded, std::numeric_limits<T>::infinity())
+                               : rounded;
+    }
 };
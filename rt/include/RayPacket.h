@@ -0,0 +1,168 @@
+/**
+ *    Copyright 2020 Jannik Bamberger
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#pragma once
+
+#include "BoundingBox.h"
+#include "Entity.h"
+#include "Ray.h"
+#include <array>
+#include <cstdint>
+#include <glm/glm.hpp>
+#include <limits>
+
+/**
+ * Rays which are traced through the scene together, e.g. the primary rays of a block of pixels.
+ * Coherent rays visit mostly the same nodes of the acceleration structures, hence a node is
+ * fetched once for all of them and a subtree which no ray enters is culled with a single test.
+ * The rays are selected by bit masks. Like for a single ray, the interval of a ray is shrunk to
+ * the closest hit found so far.
+ */
+struct RayPacket {
+    /**
+     * Maximum number of rays, one bit per ray in a mask.
+     */
+    constexpr static size_t max_size = 64;
+
+    std::array<Ray, max_size> rays;
+    /// Closest hit of every ray, only valid if the bit of the ray is set in found
+    std::array<Hit, max_size> hits;
+    /// Mask of the rays which hit a surface
+    uint64_t found = 0;
+    /// Number of rays in the packet
+    size_t size = 0;
+
+    /**
+     * Appends a ray to the packet.
+     */
+    void add(const Ray& ray)
+    {
+        rays[size] = ray;
+        hits[size] = Hit();
+        size++;
+    }
+
+    /**
+     * Removes all rays.
+     */
+    void clear()
+    {
+        size = 0;
+        found = 0;
+    }
+
+    /**
+     * Returns the mask of all rays of the packet.
+     */
+    [[nodiscard]] uint64_t all() const { return size == max_size ? ~0ull : (1ull << size) - 1; }
+};
+
+/**
+ * Bounds of the slab distances of several rays with a common origin, evaluated with interval
+ * arithmetic. The rays are given in the precision T, i.e. as Ray or TraversalRay. For a fixed
+ * plane the distance (plane - origin) * inv_dir is a monotonic function of inv_dir, also after
+ * rounding, hence its extrema over the rays are attained at the smallest and the largest
+ * reciprocal. The bounds are therefore exact and a box which the test culls is missed by every
+ * single ray. Axes on which the rays point in different directions, start at different
+ * coordinates or which contain an axis-parallel ray are not bounded.
+ */
+template <typename T>
+struct RayInterval {
+    glm::vec<3, T> near_origin{};
+    glm::vec<3, T> far_origin{};
+    glm::vec<3, T> inv_min{};
+    glm::vec<3, T> inv_max{};
+    std::array<uint8_t, 3> sign{};
+    std::array<bool, 3> bounded{};
+    /// smallest start and largest end of the intervals of the rays
+    T t_min = 0;
+    T t_max = 0;
+
+    /**
+     * Bounds the selected rays. Axes on which the converted origins of the rays differ are not
+     * bounded.
+     *
+     * @param rays Rays or TraversalRays with the precision T
+     * @param mask the selected rays, at least one
+     */
+    template <typename R>
+    RayInterval(const R* rays, uint64_t mask)
+    {
+        auto first = true;
+        std::array<bool, 3> mixed{};
+        for (size_t i = 0; mask != 0; i++, mask >>= 1) {
+            if ((mask & 1) == 0) {
+                continue;
+            }
+            const auto& ray = rays[i];
+            if (first) {
+                near_origin = ray.nearOrigin();
+                far_origin = ray.farOrigin();
+                inv_min = ray.inv_dir;
+                inv_max = ray.inv_dir;
+                sign = ray.sign;
+                t_min = ray.t_min;
+                t_max = ray.t_max;
+                first = false;
+                continue;
+            }
+            inv_min = glm::min(inv_min, ray.inv_dir);
+            inv_max = glm::max(inv_max, ray.inv_dir);
+            for (auto a = 0; a < 3; a++) {
+                mixed[a] = mixed[a] || ray.sign[a] != sign[a] ||
+                           ray.nearOrigin()[a] != near_origin[a] ||
+                           ray.farOrigin()[a] != far_origin[a];
+            }
+            t_min = glm::min(t_min, ray.t_min);
+            t_max = glm::max(t_max, ray.t_max);
+        }
+        for (auto a = 0; a < 3; a++) {
+            bounded[a] = !mixed[a] && std::isfinite(inv_min[a]) && std::isfinite(inv_max[a]);
+        }
+    }
+
+    /**
+     * Checks if any of the rays may enter the box. Performs the operations of
+     * BoundingBox::intersect with the bounds of the reciprocals.
+     *
+     * @param min lower corner of the box
+     * @param max upper corner of the box
+     * @param entry outputs a lower bound of the entry distances of the rays
+     * @return false if every ray misses the box
+     */
+    [[nodiscard]] bool
+    mayIntersect(const glm::vec<3, T>& min, const glm::vec<3, T>& max, T& entry) const
+    {
+        constexpr auto slack = BoundingBox::slabSlack<T>();
+
+        auto t_near = t_min;
+        auto t_far = t_max;
+        for (auto a = 0; a < 3; a++) {
+            if (!bounded[a]) {
+                continue;
+            }
+            const auto d_near = (sign[a] ? max[a] : min[a]) - near_origin[a];
+            const auto d_far = (sign[a] ? min[a] : max[a]) - far_origin[a];
+            const auto t0 = d_near * (d_near >= 0 ? inv_min[a] : inv_max[a]);
+            const auto t1 = d_far * (d_far >= 0 ? inv_max[a] : inv_min[a]) * slack;
+            t_near = t0 > t_near ? t0 : t_near;
+            t_far = t1 < t_far ? t1 : t_far;
+        }
+        entry = t_near;
+        return t_near <= t_far;
+    }
+};
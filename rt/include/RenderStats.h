@@ -0,0 +1,94 @@
+/**
+ *    Copyright 2020 Jannik Bamberger
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <ostream>
+#include <string>
+
+/**
+ * Counters which describe the work done while rendering a frame. Every thread records into its
+ * own instance returned by local(), the path tracer merges them into the frame totals.
+ */
+struct RenderStats {
+    /// Number of bounce depths which are counted separately. Deeper rays fall into the last bucket.
+    constexpr static size_t depth_buckets = 16;
+
+    /// Rays cast per bounce depth, 0 = primary rays
+    std::array<uint64_t, depth_buckets> rays{};
+    /// Shadow rays cast towards sampled points on the lights
+    uint64_t shadow_rays = 0;
+    /// BVH nodes whose bounding box was entered
+    uint64_t bvh_nodes = 0;
+    /// Octree nodes whose bounding box was entered
+    uint64_t octree_nodes = 0;
+    /// Ray-box intersection tests
+    uint64_t box_tests = 0;
+    /// Ray-primitive intersection tests
+    uint64_t primitive_tests = 0;
+    /// Paths which left the scene without hitting anything
+    uint64_t paths_escaped = 0;
+    /// Paths which ended because the material did not scatter
+    uint64_t paths_absorbed = 0;
+    /// Paths which were cut off at the maximum bounce depth
+    uint64_t paths_max_depth = 0;
+    /// Paths which were terminated by the russian roulette
+    uint64_t paths_roulette = 0;
+
+    /**
+     * Returns the counters of the calling thread.
+     */
+    static RenderStats& local()
+    {
+        // constant-initialized, therefore the access does not need a guard
+        static thread_local RenderStats stats;
+        return stats;
+    }
+
+    void addRay(const size_t depth) { rays[std::min(depth, depth_buckets - 1)]++; }
+
+    /**
+     * Total number of rays over all depths, including the shadow rays.
+     */
+    [[nodiscard]] uint64_t rayCount() const;
+
+    /**
+     * Total number of finished paths.
+     */
+    [[nodiscard]] uint64_t pathCount() const;
+
+    /**
+     * Average number of path segments, i.e. rays without the shadow rays, per finished path.
+     */
+    [[nodiscard]] double averagePathLength() const;
+
+    RenderStats& operator+=(const RenderStats& other);
+
+    /**
+     * Short human readable summary with the average cost per ray.
+     */
+    [[nodiscard]] std::string summary() const;
+
+    /**
+     * Writes all counters as JSON object.
+     * @param os output stream
+     * @param indent prefix of every line after the first, used to nest the object
+     */
+    void writeJson(std::ostream& os, const std::string& indent = "") const;
+};
@@ -0,0 +1,175 @@
+/**
+ *    Copyright 2020 Jannik Bamberger
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include "Pcg32.h"
+#include <array>
+#include <cstdint>
+#include <glm/glm.hpp>
+#include <memory>
+
+/**
+ * Available implementations of the Sampler interface.
+ */
+enum class SamplerType { Independent, Stratified, Halton, Sobol };
+
+/**
+ * Source of the sample values of a path. Every random decision of the path draws the next
+ * dimension from the sampler. The values of a dimension are well distributed over the samples of a
+ * pixel, depending on the implementation. Samplers are not thread-safe, every thread uses its own
+ * instance.
+ */
+class Sampler {
+  protected:
+    /// seed of the frame
+    uint64_t seed_;
+    /// linear index of the current pixel
+    uint64_t pixel_ = 0;
+    /// index of the current sample within the pixel
+    uint64_t index_ = 0;
+    /// next dimension of the current sample
+    uint32_t dimension_ = 0;
+
+  public:
+    explicit Sampler(uint64_t seed);
+    virtual ~Sampler() = default;
+
+    /**
+     * Starts a new sample. The values only depend on the seed, the pixel, the sample index and the
+     * dimension, hence the order in which the samples are generated has no effect.
+     * @param pixel linear index of the pixel
+     * @param index index of the sample within the pixel
+     */
+    virtual void startSample(uint64_t pixel, uint64_t index);
+
+    /**
+     * Returns the value of the next dimension.
+     * @return value in [0, 1)
+     */
+    virtual double get1D() = 0;
+
+    /**
+     * Returns the values of the next two dimensions. The pair is stratified jointly.
+     * @return values in [0, 1)^2
+     */
+    virtual glm::dvec2 get2D() = 0;
+};
+
+/**
+ * Uniform random values without any stratification.
+ */
+class IndependentSampler final : public Sampler {
+    Pcg32 engine_;
+
+  public:
+    explicit IndependentSampler(uint64_t seed);
+    void startSample(uint64_t pixel, uint64_t index) override;
+    double get1D() override;
+    glm::dvec2 get2D() override;
+};
+
+/**
+ * Jittered stratified sampling. Every dimension is split into one stratum per sample, 2D samples
+ * use a square grid. The strata are assigned to the samples by a random permutation per pixel and
+ * dimension, hence the dimensions are not correlated. A pixel may take more samples than there
+ * are strata, e.g. with adaptive sampling or a time budget. Every further block of samples then
+ * covers the strata again with its own permutation.
+ */
+class StratifiedSampler final : public Sampler {
+    uint32_t strata_1d_;
+    uint32_t strata_2d_;
+
+  public:
+    /**
+     * @param seed seed of the frame
+     * @param samples expected number of samples per pixel, the number of strata
+     */
+    StratifiedSampler(uint64_t seed, size_t samples);
+    double get1D() override;
+    glm::dvec2 get2D() override;
+
+  private:
+    /**
+     * Returns the stratum of the current sample in the given dimension.
+     */
+    [[nodiscard]] uint32_t stratum(uint32_t dimension, uint32_t strata) const;
+
+    /**
+     * Returns the jitter of the current sample within its stratum in the given dimension.
+     */
+    [[nodiscard]] double jitter(uint32_t dimension) const;
+};
+
+/**
+ * Halton sequence with a prime base per dimension. Every pixel applies a random rotation to each
+ * dimension, such that neighbouring pixels are not correlated. Dimensions beyond the prime table
+ * fall back to independent random values.
+ */
+class HaltonSampler final : public Sampler {
+  public:
+    explicit HaltonSampler(uint64_t seed);
+    double get1D() override;
+    glm::dvec2 get2D() override;
+
+  private:
+    [[nodiscard]] double sample(uint32_t dimension) const;
+};
+
+/**
+ * Owen-scrambled Sobol sequence with hash-based scrambling by Burley (2020). The dimensions are
+ * grouped in sets of four. Every set shuffles the sample indices with its own seed, which pads the
+ * four Sobol dimensions to an arbitrary number of dimensions.
+ */
+class SobolSampler final : public Sampler {
+    /// hash of the seed and the pixel
+    uint32_t pixel_seed_ = 0;
+    /// the set of dimensions of the cached values
+    uint32_t set_ = 0;
+    /// seed of the current set of dimensions
+    uint32_t set_seed_ = 0;
+    /// unscrambled Sobol point of the shuffled sample index in the current set of dimensions
+    std::array<uint32_t, 4> set_point_{};
+
+  public:
+    explicit SobolSampler(uint64_t seed);
+    void startSample(uint64_t pixel, uint64_t index) override;
+    double get1D() override;
+    glm::dvec2 get2D() override;
+
+    /**
+     * Returns the unscrambled Sobol point of the index as 32 bit fixed point number.
+     * @param index index of the point
+     * @param dimension dimension in [0, 4)
+     */
+    static uint32_t sobol(uint32_t index, uint32_t dimension);
+
+  private:
+    /**
+     * Shuffles the sample index for the given set of dimensions and computes its Sobol point.
+     */
+    void startSet(uint32_t set);
+
+    double sample(uint32_t dimension);
+};
+
+/**
+ * Creates a sampler of the given type.
+ * @param type the sampler implementation
+ * @param seed seed of the frame
+ * @param samples number of samples per pixel
+ */
+std::unique_ptr<Sampler> makeSampler(SamplerType type, uint64_t seed, size_t samples);
@@ -16,6 +16,7 @@
 
 #pragma once
 
+#include "LightList.h"
 #include "Material.h"
 #include "ObjReader.h"
 #include "Octree.h"
@@ -46,6 +47,7 @@ class Scene {
 
     std::filesystem::path share_dir_;
     std::vector<std::unique_ptr<Entity>> entities_;
+    std::vector<std::unique_ptr<Material>> materials_;
     std::shared_ptr<Octree> tree_;
 
   public:
@@ -121,6 +123,19 @@ class Scene {
      */
     std::shared_ptr<Octree> getTree();
 
+    /**
+     * Collects the emitting primitives of all entities. The list references the entities, hence
+     * it must not be used after the scene is changed.
+     * @return the light sources of the scene
+     */
+    [[nodiscard]] std::shared_ptr<const LightList> getLights() const;
+
+    /**
+     * Returns the total construction time of all bounding volume hierarchies in the scene.
+     * @return build time in seconds
+     */
+    [[nodiscard]] double bvhBuildSeconds() const;
+
   private:
     /**
      * Searches for the specified relative file name in the resource directory. If the function
@@ -136,4 +151,18 @@ class Scene {
      * @param entity the entity to add
      */
     void insert(std::unique_ptr<Entity> entity);
+
+    /**
+     * Creates a material which is owned by the scene. Entities and hits only hold non-owning
+     * pointers, the material lives until the scene is cleared.
+     * @tparam T type of the material
+     * @param args constructor arguments of the material
+     * @return pointer to the new material
+     */
+    template <typename T, typename... Args>
+    const Material* makeMaterial(Args&&... args)
+    {
+        materials_.push_back(std::make_unique<T>(std::forward<Args>(args)...));
+        return materials_.back().get();
+    }
 };
@@ -0,0 +1,94 @@
+/**
+ *    Copyright 2020 Jannik Bamberger
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#pragma once
+
+#include "Ray.h"
+#include <array>
+#include <cstdint>
+#include <glm/glm.hpp>
+
+/**
+ * Up to four triangles in structure-of-arrays layout, i.e. every coordinate of the corner a and
+ * the edges ab and ac is stored for all lanes consecutively. This allows to test all triangles
+ * of the packet with one vectorized Moeller-Trumbore kernel. Unused lanes have zero edges and
+ * are therefore never hit.
+ */
+struct TrianglePacket {
+    /**
+     * Number of triangles per packet.
+     */
+    constexpr static uint32_t width = 4;
+
+    using Lanes = std::array<double, width>;
+
+    std::array<Lanes, 3> a{};
+    std::array<Lanes, 3> ab{};
+    std::array<Lanes, 3> ac{};
+    /// Index of the triangle of each lane in the primitives of the owner
+    std::array<uint32_t, width> index{};
+    /// Number of used lanes, the used lanes come first
+    uint32_t count = 0;
+
+    /**
+     * Stores the triangle given by a corner and the two edges starting at it in the next free
+     * lane.
+     *
+     * @param index index of the triangle in the primitives of the owner
+     */
+    void add(const glm::dvec3& a, const glm::dvec3& ab, const glm::dvec3& ac, uint32_t index);
+
+    /**
+     * Finds the closest intersection of the ray with the triangles of the packet within the
+     * interval (ray.t_min, t_max). The vectorized kernel is used if the CPU supports it. The
+     * result is bit-identical to testing the lanes one after another with Triangle::intersect.
+     *
+     * @param lane outputs the lane of the closest hit
+     * @param t outputs the distance of the intersection
+     * @param barycentric outputs the coordinates of the intersection in the basis ab, ac
+     * @return true if any triangle is hit
+     */
+    bool intersect(const Ray& ray,
+                   double t_max,
+                   uint32_t& lane,
+                   double& t,
+                   glm::dvec2& barycentric) const;
+
+    /**
+     * Portable implementation of intersect() which tests the lanes one after another.
+     */
+    bool intersectScalar(const Ray& ray,
+                         double t_max,
+                         uint32_t& lane,
+                         double& t,
+                         glm::dvec2& barycentric) const;
+
+    /**
+     * Implementation of intersect() with AVX instructions. Must only be called if
+     * simdSupported() returns true.
+     */
+    bool intersectSimd(const Ray& ray,
+                       double t_max,
+                       uint32_t& lane,
+                       double& t,
+                       glm::dvec2& barycentric) const;
+
+    /**
+     * Checks once whether the CPU which runs the program supports the vectorized kernel.
+     */
+    static bool simdSupported();
+};
@@ -14,164 +14,787 @@
  * limitations under the License.
  */
 
+
 #include "BVH.h"
 
-class BVH::Node : public Entity {
-    BoundingBox bbox_;
+#include "ObjReader.h"
+#include "RayPacket.h"
+#include "RenderStats.h"
+#include <algorithm>
+#include <array>
+#include <bitset>
+#include <cassert>
+#include <chrono>
+#include <cmath>
+#include <iterator>
+#include <limits>
+#include <tuple>
 
-  public:
-    explicit Node(BoundingBox bbox) : bbox_(bbox) {}
-    ~Node() override = default;
-    [[nodiscard]] BoundingBox boundingBox() const override { return bbox_; }
-};
+#if defined(__SSE__) || defined(_M_X64)
+#include <xmmintrin.h>
+#endif
+
+namespace {
+/// Converts to single precision and rounds towards negative infinity.
+glm::vec3 roundDown(const glm::dvec3& v)
+{
+    glm::vec3 r(v);
+    for (glm::vec3::length_type i = 0; i < 3; i++) {
+        if (static_cast<double>(r[i]) > v[i]) {
+            r[i] = std::nextafter(r[i], -std::numeric_limits<float>::infinity());
+        }
+    }
+    return r;
+}
+
+/// Converts to single precision and rounds towards positive infinity.
+glm::vec3 roundUp(const glm::dvec3& v)
+{
+    glm::vec3 r(v);
+    for (glm::vec3::length_type i = 0; i < 3; i++) {
+        if (static_cast<double>(r[i]) < v[i]) {
+            r[i] = std::nextafter(r[i], std::numeric_limits<float>::infinity());
+        }
+    }
+    return r;
+}
+
+/// Surface area of the box spanned by min and max, zero for empty boxes.
+template <typename Vec>
+double surfaceArea(const Vec& min, const Vec& max)
+{
+    const glm::dvec3 d = glm::dvec3(max) - glm::dvec3(min);
+    if (d.x < 0 || d.y < 0 || d.z < 0) {
+        return 0;
+    }
+    return 2.0 * (d.x * d.y + d.y * d.z + d.z * d.x);
+}
+
+/// Number of packets required to store the given number of triangles.
+double packetCount(size_t count)
+{
+    return static_cast<double>((count + TrianglePacket::width - 1) / TrianglePacket::width);
+}
+
+/**
+ * Moves the elements such that values[i] holds the element previously stored at
+ * values[order[i]]. Each cycle of the permutation is processed once, therefore no second array
+ * is required. The order is consumed in the process.
+ */
+template <typename T>
+void permute(std::vector<T>& values, std::vector<uint32_t>& order)
+{
+    constexpr auto done = std::numeric_limits<uint32_t>::max();
+    for (size_t i = 0; i < values.size(); i++) {
+        if (order[i] == done) {
+            continue;
+        }
+        T first = std::move(values[i]);
+        auto j = i;
+        while (order[j] != i) {
+            const auto k = order[j];
+            values[j] = std::move(values[k]);
+            order[j] = done;
+            j = k;
+        }
+        values[j] = std::move(first);
+        order[j] = done;
+    }
+}
+} // namespace
 
-class BVH::LeafNode : public BVH::Node {
+struct BVH::BuildRef {
+    glm::dvec3 min;
+    glm::dvec3 max;
+    glm::dvec3 center; // center of the bounds
+    uint32_t index;    // index of the triangle in the input
+};
 
-    std::vector<Triangle> content_;
+namespace {
+/// Bounds and number of the triangles whose center falls into a bin.
+template <typename Ref>
+struct Bin {
+    glm::dvec3 min{std::numeric_limits<double>::infinity()};
+    glm::dvec3 max{-std::numeric_limits<double>::infinity()};
+    size_t count = 0;
 
-  public:
-    explicit LeafNode(std::vector<Triangle> faces)
-        : Node(computeBBox(faces)), content_(std::move(faces))
+    void add(const Ref& ref)
     {
+        min = glm::min(min, ref.min);
+        max = glm::max(max, ref.max);
+        count++;
     }
-    ~LeafNode() override = default;
 
-    bool intersect(const Ray& ray, Hit& hit) const override
+    void add(const Bin& other)
     {
+        min = glm::min(min, other.min);
+        max = glm::max(max, other.max);
+        count += other.count;
+    }
+};
+} // namespace
 
-        auto min_dist = std::numeric_limits<double>::max();
-        for (const auto& c : content_) {
-            Hit tmp_hit;
+struct BVH::StackEntry {
+    uint32_t index; // inner node: index in nodes_, leaf: first packet
+    uint32_t count; // number of triangles of a leaf, 0 for inner nodes
+    float entry;    // entry distance of the ray into the bounds
+};
 
-            // first check the bbox
-            // TODO: as long as there are only triangles this check might be obsolete
-            if (!c.boundingBox().intersect(ray)) {
-                continue;
-            }
-            // then the actual entity
-            if (!c.intersect(ray, tmp_hit)) {
-                continue;
-            }
-            const auto tmp_dist = glm::distance(tmp_hit.pos, ray.origin);
-            if (tmp_dist < min_dist) {
-                hit = tmp_hit;
-                min_dist = tmp_dist;
+namespace {
+/// Node or leaf which waits for the traversal of the rays of a packet.
+struct PacketStackEntry {
+    uint32_t index;  // inner node: index in nodes_, leaf: first packet
+    uint32_t count;  // number of triangles of a leaf, 0 for inner nodes
+    uint32_t parent; // node which stores the bounds in the slot
+    uint32_t slot;
+    uint64_t mask; // rays which may enter the bounds
+    float entry;   // lower bound of the entry distances of these rays
+};
+} // namespace
+
+struct BVH::BuildNode {
+    BoundingBox bbox;
+    std::array<std::unique_ptr<BuildNode>, 2> children;
+    size_t begin = 0; // first reference of a leaf
+    size_t count = 0; // number of references in a leaf
+
+    explicit BuildNode(BoundingBox bbox) : bbox(bbox) {}
+
+    [[nodiscard]] bool isLeaf() const { return children[0] == nullptr; }
+};
+
+BVH::BVH(std::vector<Triangle> faces, size_t cutoffSize, SplitMethod splitMethod)
+    : cutoff_size_(std::min<size_t>(cutoffSize, std::numeric_limits<uint16_t>::max())),
+      split_method_(splitMethod), bbox_(obj::computeBBox(faces))
+{
+    if (faces.empty()) {
+        return;
+    }
+    assert(faces.size() < std::numeric_limits<uint32_t>::max());
+    const auto t0 = std::chrono::steady_clock::now();
+
+    std::vector<BuildRef> refs(faces.size());
+#pragma omp parallel for schedule(static)
+    for (int64_t i = 0; i < static_cast<int64_t>(faces.size()); i++) {
+        const auto& face = faces[i];
+        auto& ref = refs[i];
+        ref.min = glm::min(face.A, glm::min(face.B, face.C));
+        ref.max = glm::max(face.A, glm::max(face.B, face.C));
+        ref.center = (ref.min + ref.max) / 2.0;
+        ref.index = static_cast<uint32_t>(i);
+    }
+
+    std::unique_ptr<BuildNode> root;
+#pragma omp parallel shared(root, refs)
+#pragma omp single
+    root = construct(0, refs, 0, refs.size());
+
+    // The leaves cover the references in depth-first order. Reordering the triangles accordingly
+    // makes every leaf a contiguous range of primitives_.
+    std::vector<uint32_t> order(refs.size());
+    std::transform(refs.begin(), refs.end(), order.begin(), [](const auto& r) { return r.index; });
+    refs = std::vector<BuildRef>();
+    permute(faces, order);
+    primitives_ = std::move(faces);
+
+    flatten(*root);
+
+    const auto t1 = std::chrono::steady_clock::now();
+    build_seconds_ = std::chrono::duration<double>(t1 - t0).count();
+}
+
+BVH::~BVH() = default;
+
+BoundingBox BVH::boundingBox() const { return bbox_; }
+
+bool BVH::intersect(const Ray& ray, Hit& hit) const
+{
+    return !primitives_.empty() && intersectSubtree(0, ray, hit);
+}
+
+bool BVH::intersectSubtree(const uint32_t root, const Ray& ray, Hit& hit) const
+{
+    // The interval of the ray is clipped to the closest hit. Nodes beyond it are skipped. The
+    // nodes are tested in single precision, the triangles with the double precision ray.
+    auto clipped = ray;
+    TraversalRay<float> traversal(ray);
+
+    std::array<StackEntry, stack_size_> stack; // NOLINT(cppcoreguidelines-pro-type-member-init)
+    size_t stack_size = 0;
+    stack[stack_size++] = {root, 0, traversal.t_min};
+
+    auto found = false;
+    uint64_t tested = 0;
+    uint64_t visited = 0;
+    while (stack_size > 0) {
+        const auto item = stack[--stack_size];
+        if (item.entry > traversal.t_max) {
+            continue; // a closer hit was found after the entry was pushed
+        }
+
+        if (item.count > 0) {
+            const auto first = packets_.begin() + item.index;
+            const auto last = first + (item.count + TrianglePacket::width - 1) /
+                                          TrianglePacket::width;
+            for (auto p = first; p != last; ++p) {
+                uint32_t lane;
+                double t;
+                glm::dvec2 barycentric;
+                if (p->intersect(clipped, clipped.t_max, lane, t, barycentric)) {
+                    hit.t = t;
+                    hit.entity = &primitives_[p->index[lane]];
+                    hit.barycentric = barycentric;
+                    clipped.t_max = t;
+                    traversal.setMax(t);
+                    found = true;
+                }
             }
+            continue;
         }
 
-        return min_dist < std::numeric_limits<double>::max();
+        const auto& node = nodes_[item.index];
+        std::array<float, WideNode::width> entry; // NOLINT(cppcoreguidelines-pro-type-member-init)
+        const auto mask = intersectChildren(node, traversal, entry);
+        tested += node.child_count;
+        visited += std::bitset<WideNode::width>(mask).count();
+        pushChildren(node, mask, entry, stack.data(), stack_size);
     }
 
-    void setMaterial(std::shared_ptr<Material> material) override
-    {
-        this->material_ = material;
-        for (auto& face : content_) {
-            face.setMaterial(material);
-        }
+    auto& stats = RenderStats::local();
+    stats.box_tests += tested;
+    stats.bvh_nodes += visited;
+    return found;
+}
+
+bool BVH::occluded(const Ray& ray, const double t_max) const
+{
+    if (primitives_.empty()) {
+        return false;
     }
 
-  private:
-    static BoundingBox computeBBox(const std::vector<Triangle>& objects)
-    {
-        if (objects.empty()) {
-            return BoundingBox{{0, 0, 0}, {0, 0, 0}};
-        }
+    auto clipped = ray;
+    clipped.t_max = glm::min(ray.t_max, t_max);
+    const TraversalRay<float> traversal(clipped);
 
-        const auto b1 = objects[0].boundingBox();
-        auto min = b1.min;
-        auto max = b1.max;
+    std::array<StackEntry, stack_size_> stack; // NOLINT(cppcoreguidelines-pro-type-member-init)
+    size_t stack_size = 0;
+    stack[stack_size++] = {0, 0, traversal.t_min};
 
-        for (const auto& t : objects) {
-            const auto bbox = t.boundingBox();
-            min = glm::min(min, bbox.min);
-            max = glm::max(max, bbox.max);
+    auto found = false;
+    uint64_t tested = 0;
+    uint64_t visited = 0;
+    while (stack_size > 0 && !found) {
+        const auto item = stack[--stack_size];
+        if (item.count > 0) {
+            const auto first = packets_.begin() + item.index;
+            const auto last = first + (item.count + TrianglePacket::width - 1) /
+                                          TrianglePacket::width;
+            found = std::any_of(first, last, [&clipped](const TrianglePacket& p) {
+                uint32_t lane;
+                double t;
+                glm::dvec2 barycentric;
+                return p.intersect(clipped, clipped.t_max, lane, t, barycentric);
+            });
+            continue;
         }
 
-        return BoundingBox{min, max};
+        // any hit terminates the query, the nearer children are still more likely to contain one
+        const auto& node = nodes_[item.index];
+        std::array<float, WideNode::width> entry; // NOLINT(cppcoreguidelines-pro-type-member-init)
+        const auto mask = intersectChildren(node, traversal, entry);
+        tested += node.child_count;
+        visited += std::bitset<WideNode::width>(mask).count();
+        pushChildren(node, mask, entry, stack.data(), stack_size);
     }
-};
 
-class BVH::InnerNode : public BVH::Node {
-    std::vector<std::unique_ptr<Node>> children_;
+    auto& stats = RenderStats::local();
+    stats.box_tests += tested;
+    stats.bvh_nodes += visited;
+    return found;
+}
 
-  public:
-    explicit InnerNode(std::unique_ptr<Node> lower, std::unique_ptr<Node> upper)
-        : Node(BoundingBox::unite(lower->boundingBox(), upper->boundingBox()))
-    {
-        children_.push_back(std::move(lower));
-        children_.push_back(std::move(upper));
+void BVH::intersectPacket(RayPacket& packet, const uint64_t active) const
+{
+    if (primitives_.empty() || active == 0) {
+        return;
     }
-    ~InnerNode() override = default;
 
-    bool intersect(const Ray& ray, Hit& hit) const override
-    {
-        auto min_dist = std::numeric_limits<double>::max();
-        for (const auto& c : children_) {
-            Hit tmp_hit;
-            if (!c->boundingBox().intersect(ray)) {
+    // single precision copies of the rays for the box tests, shrunk together with the rays
+    std::array<TraversalRay<float>, RayPacket::max_size> traversal;
+    for (size_t i = 0; i < packet.size; i++) {
+        if ((active >> i & 1) != 0) {
+            traversal[i] = TraversalRay<float>(packet.rays[i]);
+        }
+    }
+    const auto record = [&](const size_t i, const double t) {
+        packet.rays[i].t_max = t;
+        traversal[i].setMax(t);
+        packet.found |= 1ull << i;
+    };
+    const auto bounds = [](const WideNode& node, const uint32_t slot) {
+        return std::make_pair(glm::vec3(node.min[0][slot], node.min[1][slot], node.min[2][slot]),
+                              glm::vec3(node.max[0][slot], node.max[1][slot], node.max[2][slot]));
+    };
+
+    // The inner nodes are only tested with interval arithmetic and with the first ray which
+    // enters a child, i.e. a child inherits the rays which may enter it. The exact tests of the
+    // single rays are deferred to the leaves.
+    RayInterval<float> interval(traversal.data(), active);
+    std::array<PacketStackEntry, stack_size_> stack; // NOLINT
+    size_t stack_size = 0;
+    stack[stack_size++] = {0, 0, 0, 0, active, -std::numeric_limits<float>::infinity()};
+
+    uint64_t tested = 0;
+    uint64_t visited = 0;
+    while (stack_size > 0) {
+        const auto item = stack[--stack_size];
+
+        // drop the rays which found a closer hit after the entry was pushed
+        auto mask = item.mask;
+        auto t_max = -std::numeric_limits<float>::infinity();
+        for (size_t i = 0; i < packet.size; i++) {
+            if ((mask >> i & 1) == 0) {
+                continue;
+            }
+            if (item.entry > traversal[i].t_max) {
+                mask &= ~(1ull << i);
+            } else {
+                t_max = std::max(t_max, traversal[i].t_max);
+            }
+        }
+        if (mask == 0) {
+            continue;
+        }
+
+        if (item.count > 0) {
+            const auto [min, max] = bounds(nodes_[item.parent], item.slot);
+            const auto first = packets_.begin() + item.index;
+            const auto last = first + (item.count + TrianglePacket::width - 1) /
+                                          TrianglePacket::width;
+            for (size_t i = 0; i < packet.size; i++) {
+                float entry;
+                if ((mask >> i & 1) == 0) {
+                    continue;
+                }
+                tested++;
+                if (!BoundingBox::intersect(min, max, traversal[i], entry)) {
+                    continue;
+                }
+                visited++;
+                for (auto p = first; p != last; ++p) {
+                    uint32_t lane;
+                    double t;
+                    glm::dvec2 barycentric;
+                    auto& hit = packet.hits[i];
+                    if (p->intersect(packet.rays[i], packet.rays[i].t_max, lane, t, barycentric)) {
+                        hit.t = t;
+                        hit.entity = &primitives_[p->index[lane]];
+                        hit.barycentric = barycentric;
+                        record(i, t);
+                    }
+                }
+            }
+            continue;
+        }
+
+        if (std::bitset<RayPacket::max_size>(mask).count() < packet_min_rays_) {
+            // the rays diverged, continue with the single ray traversal
+            for (size_t i = 0; i < packet.size; i++) {
+                if ((mask >> i & 1) != 0 &&
+                    intersectSubtree(item.index, packet.rays[i], packet.hits[i])) {
+                    record(i, packet.hits[i].t);
+                }
+            }
+            continue;
+        }
+
+        // cull the children which no ray enters according to the interval bounds
+        const auto& node = nodes_[item.index];
+        interval.t_max = t_max;
+        uint32_t candidates = 0;
+        std::array<float, WideNode::width> entry_bound; // NOLINT
+        for (uint32_t c = 0; c < node.child_count; c++) {
+            const auto [min, max] = bounds(node, c);
+            if (interval.mayIntersect(min, max, entry_bound[c])) {
+                candidates |= 1u << c;
+            }
+        }
+        tested += node.child_count;
+
+        // A child is entered from the first ray which hits its box on. The rays before it are
+        // known to miss the box.
+        std::array<uint64_t, WideNode::width> child_mask{};
+        auto pending = candidates;
+        for (size_t i = 0; i < packet.size && pending != 0; i++) {
+            if ((mask >> i & 1) == 0) {
                 continue;
             }
-            if (!c->intersect(ray, tmp_hit)) {
+            std::array<float, WideNode::width> entry; // NOLINT
+            const auto entered = intersectChildren(node, traversal[i], entry) & pending;
+            tested += node.child_count;
+            for (uint32_t c = 0; c < node.child_count; c++) {
+                if ((entered >> c & 1) != 0) {
+                    child_mask[c] = mask & ~((1ull << i) - 1);
+                    visited++;
+                }
+            }
+            pending &= ~entered;
+        }
+
+        // push the children such that the one with the smallest entry distance is visited first
+        std::array<PacketStackEntry, WideNode::width> children; // NOLINT
+        size_t count = 0;
+        for (uint32_t c = 0; c < node.child_count; c++) {
+            if (child_mask[c] == 0) {
                 continue;
             }
-            const auto tmp_dist = glm::distance(tmp_hit.pos, ray.origin);
-            if (tmp_dist < min_dist) {
-                hit = tmp_hit;
-                min_dist = tmp_dist;
+            const PacketStackEntry child{
+                node.child[c], node.count[c], item.index, c, child_mask[c], entry_bound[c]};
+            auto j = count++;
+            for (; j > 0 && children[j - 1].entry < child.entry; j--) {
+                children[j] = children[j - 1];
             }
+            children[j] = child;
         }
+        std::copy(children.begin(), children.begin() + count, stack.begin() + stack_size);
+        stack_size += count;
+    }
 
-        return min_dist < std::numeric_limits<double>::max();
+    auto& stats = RenderStats::local();
+    stats.box_tests += tested;
+    stats.bvh_nodes += visited;
+}
+
+uint32_t BVH::intersectChildren(const WideNode& node,
+                                const TraversalRay<float>& ray,
+                                std::array<float, WideNode::width>& entry)
+{
+#if defined(__SSE__) || defined(_M_X64)
+    // The same operations as BoundingBox::intersect for all slots. Like the scalar comparisons,
+    // max and min return their second operand if the first one is NaN.
+    const auto slack = _mm_set1_ps(BoundingBox::slabSlack<float>());
+    auto t_near = _mm_set1_ps(ray.t_min);
+    auto t_far = _mm_set1_ps(ray.t_max);
+    for (auto a = 0; a < 3; a++) {
+        const auto& near_plane = ray.sign[a] ? node.max[a] : node.min[a];
+        const auto& far_plane = ray.sign[a] ? node.min[a] : node.max[a];
+        const auto near_origin = _mm_set1_ps(ray.near_origin[a]);
+        const auto far_origin = _mm_set1_ps(ray.far_origin[a]);
+        const auto inv_dir = _mm_set1_ps(ray.inv_dir[a]);
+        const auto t0 =
+            _mm_mul_ps(_mm_sub_ps(_mm_load_ps(near_plane.data()), near_origin), inv_dir);
+        const auto t1 = _mm_mul_ps(
+            _mm_mul_ps(_mm_sub_ps(_mm_load_ps(far_plane.data()), far_origin), inv_dir), slack);
+        t_near = _mm_max_ps(t0, t_near);
+        t_far = _mm_min_ps(t1, t_far);
     }
+    _mm_storeu_ps(entry.data(), t_near);
+    return static_cast<uint32_t>(_mm_movemask_ps(_mm_cmple_ps(t_near, t_far)));
+#else
+    uint32_t mask = 0;
+    for (uint32_t i = 0; i < node.child_count; i++) {
+        const glm::vec3 min(node.min[0][i], node.min[1][i], node.min[2][i]);
+        const glm::vec3 max(node.max[0][i], node.max[1][i], node.max[2][i]);
+        if (BoundingBox::intersect(min, max, ray, entry[i])) {
+            mask |= 1u << i;
+        }
+    }
+    return mask;
+#endif
+}
 
-    void setMaterial(std::shared_ptr<Material> material) override
-    {
-        this->material_ = material;
-        for (auto& n : children_) {
-            n->setMaterial(material);
+void BVH::pushChildren(const WideNode& node,
+                       const uint32_t mask,
+                       const std::array<float, WideNode::width>& entry,
+                       StackEntry* stack,
+                       size_t& stack_size)
+{
+    // insertion sort of the entered children by decreasing entry distance
+    std::array<StackEntry, WideNode::width> children; // NOLINT
+    size_t count = 0;
+    for (uint32_t i = 0; i < node.child_count; i++) {
+        if ((mask & (1u << i)) == 0) {
+            continue;
         }
+        const StackEntry child{node.child[i], node.count[i], entry[i]};
+        auto j = count++;
+        for (; j > 0 && children[j - 1].entry < child.entry; j--) {
+            children[j] = children[j - 1];
+        }
+        children[j] = child;
     }
-};
+    std::copy(children.begin(), children.begin() + count, stack + stack_size);
+    stack_size += count;
+}
 
-BVH::BVH(std::vector<Triangle> faces, size_t cutoffSize) : cutoff_size_(cutoffSize)
+void BVH::setMaterial(const Material* material)
 {
-    root_ = construct(0, std::move(faces));
+    for (auto& face : primitives_) {
+        face.setMaterial(material);
+    }
+    this->material_ = material;
 }
 
-BoundingBox BVH::boundingBox() const { return root_->boundingBox(); }
+void BVH::collectLights(std::vector<const Entity*>& lights) const
+{
+    for (const auto& face : primitives_) {
+        face.collectLights(lights);
+    }
+}
 
-bool BVH::intersect(const Ray& ray, Hit& hit) const
+std::unique_ptr<BVH::BuildNode>
+BVH::construct(size_t depth, std::vector<BuildRef>& refs, size_t begin, size_t end) const
 {
-    if (!root_->boundingBox().intersect(ray)) {
-        return false;
+    Bin<BuildRef> bounds;
+    for (auto i = begin; i < end; i++) {
+        bounds.add(refs[i]);
+    }
+    const BoundingBox bbox(bounds.min, bounds.max);
+
+    glm::dvec3::length_type axis = 0;
+    const auto count = end - begin;
+    const auto middle = count <= 1 || depth + 1 >= max_depth_
+                            ? begin
+                            : partition(depth, bbox, refs, begin, end, axis);
+    auto node = std::make_unique<BuildNode>(bbox);
+    if (middle == begin) {
+        node->begin = begin;
+        node->count = count;
+        return node;
+    }
+
+    depth++;
+    if (count >= task_size_) {
+        // The children cover disjoint ranges of the references, so they can be built concurrently.
+#pragma omp task shared(node, refs) firstprivate(depth, begin, middle)
+        node->children[0] = construct(depth, refs, begin, middle);
+        node->children[1] = construct(depth, refs, middle, end);
+#pragma omp taskwait
+    } else {
+        node->children[0] = construct(depth, refs, begin, middle);
+        node->children[1] = construct(depth, refs, middle, end);
     }
-    return root_->intersect(ray, hit);
+    return node;
 }
 
-void BVH::setMaterial(std::shared_ptr<Material> material)
+size_t BVH::partition(const size_t depth,
+                      const BoundingBox& bbox,
+                      std::vector<BuildRef>& refs,
+                      const size_t begin,
+                      const size_t end,
+                      glm::dvec3::length_type& axis) const
 {
-    this->material_ = material;
-    root_->setMaterial(material);
+    switch (split_method_) {
+    case SplitMethod::Median:
+        return partitionMedian(depth, refs, begin, end, axis);
+    case SplitMethod::SAH:
+        return partitionSAH(bbox, refs, begin, end, axis);
+    }
+    return begin;
 }
 
-std::unique_ptr<BVH::Node> BVH::construct(size_t depth, std::vector<Triangle> faces)
+size_t BVH::partitionMedian(const size_t depth,
+                            std::vector<BuildRef>& refs,
+                            const size_t begin,
+                            const size_t end,
+                            glm::dvec3::length_type& axis) const
 {
-    if (faces.size() < cutoff_size_) {
-        return std::make_unique<LeafNode>(std::move(faces));
+    if (end - begin < cutoff_size_) {
+        return begin;
     }
 
     const glm::dvec3::length_type cc =
         depth % 3; // determine if x, y or z is used for sorting -> round robin
-    const auto comp = [cc](const Triangle& a, const Triangle& b) {
-        // compare by center of mass
-        return a.A[cc] + a.B[cc] + a.C[cc] < b.A[cc] + b.B[cc] + b.C[cc];
+    const auto comp = [cc](const BuildRef& a, const BuildRef& b) {
+        return a.center[cc] < b.center[cc];
     };
-    std::sort(faces.begin(), faces.end(), comp);
 
-    const auto middle = faces.size() / 2;
-    std::vector<Triangle> lower(faces.begin(), faces.begin() + middle);
-    std::vector<Triangle> upper(faces.begin() + middle, faces.end());
+    const auto middle = begin + (end - begin) / 2;
+    std::nth_element(refs.begin() + begin, refs.begin() + middle, refs.begin() + end, comp);
+    axis = cc;
+    return middle;
+}
 
-    depth++;
-    return std::make_unique<InnerNode>(construct(depth, lower), construct(depth, upper));
+size_t BVH::partitionSAH(const BoundingBox& bbox,
+                         std::vector<BuildRef>& refs,
+                         const size_t begin,
+                         const size_t end,
+                         glm::dvec3::length_type& axis) const
+{
+    const auto count = end - begin;
+
+    Bin<BuildRef> centers;
+    for (auto i = begin; i < end; i++) {
+        centers.min = glm::min(centers.min, refs[i].center);
+        centers.max = glm::max(centers.max, refs[i].center);
+    }
+
+    const auto binIndex = [&centers](const BuildRef& ref, glm::dvec3::length_type a) {
+        const auto extent = centers.max[a] - centers.min[a];
+        const auto b = static_cast<size_t>(bin_count_ * (ref.center[a] - centers.min[a]) / extent);
+        return std::min(b, bin_count_ - 1);
+    };
+
+    // Evaluate the cost of all bin boundaries on all axes. The cost of a split is relative to the
+    // surface area of the node because this is the conditional probability that a ray hits a child.
+    auto best_cost = std::numeric_limits<double>::infinity();
+    size_t best_bin = 0;
+    for (glm::dvec3::length_type a = 0; a < 3; a++) {
+        if (centers.max[a] <= centers.min[a]) {
+            continue;
+        }
+
+        std::array<Bin<BuildRef>, bin_count_> bins;
+        for (auto i = begin; i < end; i++) {
+            bins[binIndex(refs[i], a)].add(refs[i]);
+        }
+
+        // sweep from the right to obtain the cost of all upper partitions
+        std::array<double, bin_count_> upper_cost{};
+        Bin<BuildRef> upper;
+        for (auto i = bin_count_ - 1; i > 0; i--) {
+            upper.add(bins[i]);
+            upper_cost[i] = surfaceArea(upper.min, upper.max) * packetCount(upper.count);
+        }
+
+        Bin<BuildRef> lower;
+        for (size_t i = 1; i < bin_count_; i++) {
+            lower.add(bins[i - 1]);
+            const auto cost =
+                surfaceArea(lower.min, lower.max) * packetCount(lower.count) + upper_cost[i];
+            if (lower.count > 0 && lower.count < count && cost < best_cost) {
+                best_cost = cost;
+                best_bin = i;
+                axis = a;
+            }
+        }
+    }
+
+    if (best_bin == 0) {
+        // All centers coincide. Splitting does not help unless the node is too large.
+        if (count < cutoff_size_) {
+            return begin;
+        }
+        return begin + count / 2;
+    }
+
+    const auto area = surfaceArea(bbox.min, bbox.max);
+    best_cost = area > 0 ? traversal_cost_ + intersection_cost_ * best_cost / area
+                         : std::numeric_limits<double>::infinity();
+    const auto leaf_cost = intersection_cost_ * packetCount(count);
+    if (count < cutoff_size_ && leaf_cost <= best_cost) {
+        return begin;
+    }
+
+    const auto middle = std::partition(refs.begin() + begin, refs.begin() + end,
+                                       [&](const BuildRef& ref) {
+                                           return binIndex(ref, axis) < best_bin;
+                                       });
+    return static_cast<size_t>(std::distance(refs.begin(), middle));
+}
+
+uint32_t BVH::flatten(const BuildNode& node)
+{
+    // Pull up the children of the largest inner child until the node is full. A large child is
+    // entered by many rays, hence skipping it saves the most box tests.
+    std::vector<const BuildNode*> children;
+    if (node.isLeaf()) {
+        children.push_back(&node);
+    } else {
+        children = {node.children[0].get(), node.children[1].get()};
+    }
+    while (children.size() < WideNode::width) {
+        auto largest = children.end();
+        auto largest_area = -1.0;
+        for (auto it = children.begin(); it != children.end(); ++it) {
+            const auto area = surfaceArea((*it)->bbox.min, (*it)->bbox.max);
+            if (!(*it)->isLeaf() && area > largest_area) {
+                largest = it;
+                largest_area = area;
+            }
+        }
+        if (largest == children.end()) {
+            break;
+        }
+        const auto* inner = *largest;
+        *largest = inner->children[0].get();
+        children.insert(largest + 1, inner->children[1].get());
+    }
+
+    const auto index = static_cast<uint32_t>(nodes_.size());
+    nodes_.emplace_back();
+    for (glm::vec3::length_type a = 0; a < 3; a++) {
+        nodes_[index].min[a].fill(std::numeric_limits<float>::infinity());
+        nodes_[index].max[a].fill(-std::numeric_limits<float>::infinity());
+    }
+    nodes_[index].child_count = static_cast<uint8_t>(children.size());
+
+    for (size_t i = 0; i < children.size(); i++) {
+        const auto& child = *children[i];
+        const auto min = roundDown(child.bbox.min);
+        const auto max = roundUp(child.bbox.max);
+        for (glm::vec3::length_type a = 0; a < 3; a++) {
+            nodes_[index].min[a][i] = min[a];
+            nodes_[index].max[a][i] = max[a];
+        }
+
+        if (child.isLeaf()) {
+            assert(child.count <= std::numeric_limits<uint16_t>::max());
+            nodes_[index].child[i] = static_cast<uint32_t>(packets_.size());
+            nodes_[index].count[i] = static_cast<uint16_t>(child.count);
+            for (auto j = child.begin; j < child.begin + child.count; j++) {
+                if ((j - child.begin) % TrianglePacket::width == 0) {
+                    packets_.emplace_back();
+                }
+                const auto& face = primitives_[j];
+                packets_.back().add(face.A, face.B - face.A, face.C - face.A,
+                                    static_cast<uint32_t>(j));
+            }
+        } else {
+            // flatten appends to nodes_, the node must be indexed again afterwards
+            const auto child_index = flatten(child);
+            nodes_[index].child[i] = child_index;
+        }
+    }
+    return index;
+}
+
+BVH::BuildStats BVH::buildStats() const
+{
+    BuildStats stats;
+    stats.build_seconds = build_seconds_;
+    if (primitives_.empty()) {
+        return stats;
+    }
+
+    // The children of a node are tested at once, hence a node costs one traversal step. Each
+    // stack entry holds the index of a node, its depth and the probability that it is entered.
+    const auto root_area = surfaceArea(bbox_.min, bbox_.max);
+    std::vector<std::tuple<uint32_t, size_t, double>> stack{{0, 0, 1.0}};
+    while (!stack.empty()) {
+        const auto [index, depth, probability] = stack.back();
+        stack.pop_back();
+        const auto& node = nodes_[index];
+
+        stats.node_count++;
+        stats.sah_cost += probability * traversal_cost_;
+        for (uint32_t i = 0; i < node.child_count; i++) {
+            const glm::vec3 min(node.min[0][i], node.min[1][i], node.min[2][i]);
+            const glm::vec3 max(node.max[0][i], node.max[1][i], node.max[2][i]);
+            const auto p = root_area > 0 ? surfaceArea(min, max) / root_area : 1.0;
+            if (node.count[i] > 0) {
+                stats.node_count++;
+                stats.leaf_count++;
+                stats.max_depth = std::max(stats.max_depth, depth + 1);
+                stats.sah_cost += p * intersection_cost_ * packetCount(node.count[i]);
+            } else {
+                stack.emplace_back(node.child[i], depth + 1, p);
+            }
+        }
+    }
+    stats.average_leaf_size =
+        static_cast<double>(primitives_.size()) / static_cast<double>(stats.leaf_count);
+    stats.traversal_bytes =
+        nodes_.size() * sizeof(WideNode) + packets_.size() * sizeof(TrianglePacket);
+    return stats;
 }
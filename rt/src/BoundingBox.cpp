@@ -35,28 +35,13 @@ bool BoundingBox::intersect(const BoundingBox& other) const
 
 bool BoundingBox::intersect(const Ray& ray) const
 {
-    // compute the intersection with each slab given by the box
-    const auto mins = (min - ray.origin) / ray.dir;
-    const auto maxes = (max - ray.origin) / ray.dir;
-
-    // build valid intervals
-    const auto t_mins = glm::min(mins, maxes);
-    const auto t_maxes = glm::max(mins, maxes);
-
-    // Intersect first and second interval
-    auto t_min = glm::max(t_mins.x, t_mins.y);
-    auto t_max = glm::min(t_maxes.x, t_maxes.y);
-    if (t_min > t_max)
-        return false;
-
-    // Intersect remaining interval with result
-    t_min = glm::max(t_min, t_mins.z);
-    t_max = glm::min(t_max, t_maxes.z);
-    if (t_min > t_max)
-        return false;
+    double entry;
+    return intersect(ray, entry);
+}
 
-    // check that the intersection is not behind the ray starting point
-    return t_max > 0;
+bool BoundingBox::intersect(const Ray& ray, double& entry) const
+{
+    return intersect(min, max, ray, entry);
 }
 
 bool BoundingBox::contains(glm::dvec3 point) const
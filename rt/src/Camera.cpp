@@ -24,11 +24,12 @@ Camera::Camera(glm::dvec3 pos, glm::dvec3 look_at, glm::dvec3 v_up)
 {
 }
 
-Ray Camera::getRay(const double x, const double y) const
+Ray Camera::getRay(const double x, const double y, Sampler& sampler) const
 {
     // apply some jitter to the input pixel position
-    const auto dx = rng();
-    const auto dy = rng();
+    const auto jitter = sampler.get2D();
+    const auto dx = jitter.x;
+    const auto dy = jitter.y;
 
     // computes the relative location of the pixel in the sensor, i.e. the middle pixel of the
     // screen is in the middle of the sensor
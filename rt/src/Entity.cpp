@@ -16,24 +16,67 @@
 
 #include "Entity.h"
 #include "Material.h"
+#include "RandomUtils.h"
+#include "RayPacket.h"
+#include "RenderStats.h"
 
 Hit::Hit() = default;
 
+void Hit::finalize(const Ray& ray)
+{
+    assert(entity != nullptr);
+    entity->finalize(ray, *this);
+}
+
+bool Hittable::occluded(const Ray& ray, const double t_max) const
+{
+    auto clipped = ray;
+    clipped.t_max = glm::min(ray.t_max, t_max);
+    Hit hit;
+    return intersect(clipped, hit);
+}
+
+void Hittable::intersectPacket(RayPacket& packet, uint64_t active) const
+{
+    for (size_t i = 0; active != 0; i++, active >>= 1) {
+        if ((active & 1) != 0 && intersect(packet.rays[i], packet.hits[i])) {
+            packet.rays[i].t_max = packet.hits[i].t;
+            packet.found |= 1ull << i;
+        }
+    }
+}
+
 ///************************************************************************************************
 /// Entity
 ///************************************************************************************************
 
-Entity::Entity()
-    : Entity(std::make_shared<LambertianMaterial>(
-          std::make_shared<ConstantTexture>(glm::dvec3{1, 0, 0})))
+namespace {
+/// Material of entities which were not assigned a material explicitly.
+const Material* defaultMaterial()
 {
+    static const LambertianMaterial material(
+        std::make_shared<ConstantTexture>(glm::dvec3{1, 0, 0}));
+    return &material;
 }
+} // namespace
+
+Entity::Entity() : Entity(defaultMaterial()) {}
+
+Entity::Entity(const Material* material) : material_(material) {}
 
-Entity::Entity(std::shared_ptr<Material> material) : material_(std::move(material)) {}
+void Entity::setMaterial(const Material* material) { this->material_ = material; }
+
+void Entity::finalize(const Ray& ray, Hit& hit) const
+{
+    hit.pos = ray.origin + hit.t * ray.dir;
+    hit.mat = material_;
+}
 
-void Entity::setMaterial(std::shared_ptr<Material> material)
+void Entity::collectLights(std::vector<const Entity*>& lights) const
 {
-    this->material_ = std::move(material);
+    if (material_->isEmissive() && area() > 0) {
+        lights.push_back(this);
+    }
 }
 
 ///************************************************************************************************
@@ -49,41 +92,99 @@ Triangle::Triangle(glm::dvec3 a, glm::dvec3 b, glm::dvec3 c)
 
 bool Triangle::intersect(const Ray& ray, Hit& hit) const
 {
-    const auto N = this->normal();
-    const auto DN = glm::dot(N, ray.dir);
-
-    // discard rays that are nearly parallel to the triangle
-    if (glm::epsilonEqual(0., DN, 1e-11)) {
+    double t;
+    glm::dvec2 barycentric;
+    if (!intersect(ray, ray.t_max, t, barycentric)) {
         return false;
     }
+    hit.t = t;
+    hit.entity = this;
+    hit.barycentric = barycentric;
+    return true;
+}
 
-    const auto c = glm::dot(A - ray.origin, N) / DN;
+bool Triangle::occluded(const Ray& ray, const double t_max) const
+{
+    double t;
+    glm::dvec2 barycentric;
+    return intersect(ray, glm::min(ray.t_max, t_max), t, barycentric);
+}
 
-    // test if the triangle is behind the ray origin
-    if (c <= 0)
-        return false;
+bool Triangle::intersect(const Ray& ray,
+                         const double t_max,
+                         double& t,
+                         glm::dvec2& barycentric) const
+{
+    return intersect(A, B - A, C - A, ray, t_max, t, barycentric);
+}
+
+bool Triangle::intersect(const glm::dvec3& a,
+                         const glm::dvec3& ab,
+                         const glm::dvec3& ac,
+                         const Ray& ray,
+                         const double t_max,
+                         double& t,
+                         glm::dvec2& barycentric)
+{
+    RenderStats::local().primitive_tests++;
 
-    // compute the intersection point
-    const auto I = ray.origin + c * ray.dir;
+    // Moeller-Trumbore: solve origin + t * dir = a + u * ab + v * ac with Cramer's rule
+    const auto P = glm::cross(ray.dir, ac);
+    const auto det = glm::dot(ab, P);
 
-    // Ray intersects plane at I, perform half-space tests
-    // The cross product points in the same direction as the normal if the point is inside of
-    // the half-space
-    if (glm::dot(N, glm::cross(B - A, I - A)) < 0)
+    // discard rays that are nearly parallel to the triangle
+    if (glm::abs(det) < 1e-14) {
         return false;
-    if (glm::dot(N, glm::cross(C - B, I - B)) < 0)
+    }
+    const auto inv_det = 1.0 / det;
+
+    // barycentric coordinates, the point is inside if u, v >= 0 and u + v <= 1
+    const auto AO = ray.origin - a;
+    const auto u = glm::dot(AO, P) * inv_det;
+    if (u < 0 || u > 1)
         return false;
-    if (glm::dot(N, glm::cross(A - C, I - C)) < 0)
+
+    const auto Q = glm::cross(AO, ab);
+    const auto v = glm::dot(ray.dir, Q) * inv_det;
+    if (v < 0 || u + v > 1)
         return false;
 
-    hit.normal = N;
-    hit.pos = I;
-    hit.uv = texMapping(I);
-    hit.mat = material_;
+    // test if the triangle is outside of the valid ray interval, e.g. behind the ray origin
+    t = glm::dot(ac, Q) * inv_det;
+    if (t <= ray.t_min || t >= t_max)
+        return false;
 
+    barycentric = {u, v};
     return true;
 }
 
+void Triangle::finalize([[maybe_unused]] const Ray& ray, Hit& hit) const
+{
+    const auto u = hit.barycentric.x;
+    const auto v = hit.barycentric.y;
+    hit.normal = normal();
+    hit.pos = A + u * (B - A) + v * (C - A);
+    hit.mat = material_;
+
+    // the barycentric coordinates are the coordinates of the hit in the basis formed by AB and AC
+    hit.uv = tA + u * tAB + v * tAC;
+    if (0.0 > hit.uv.x || hit.uv.x > 1.0 || 0.0 > hit.uv.y || hit.uv.y > 1.0) {
+        // Wrap coordinates around, i.e. similar to tiling the space with the texture
+        hit.uv -= glm::floor(hit.uv);
+    }
+}
+
+double Triangle::area() const { return 0.5 * glm::length(glm::cross(B - A, C - A)); }
+
+void Triangle::sample(const glm::dvec2& u, Hit& hit) const
+{
+    // warps the unit square onto the triangle such that the area is preserved
+    const auto su = glm::sqrt(u.x);
+    hit.entity = this;
+    hit.barycentric = {su * (1 - u.y), su * u.y};
+    finalize(Ray(), hit); // the triangle computes the attributes from the barycentric coordinates
+}
+
 BoundingBox Triangle::boundingBox() const
 {
     return BoundingBox(glm::min(A, glm::min(B, C)), glm::max(A, glm::max(B, C)));
@@ -154,6 +255,25 @@ Sphere::Sphere(const glm::dvec3 center, const double radius) : center(center), r
 
 bool Sphere::intersect(const Ray& ray, Hit& hit) const
 {
+    double t;
+    if (!intersect(ray, ray.t_max, t)) {
+        return false;
+    }
+    hit.t = t;
+    hit.entity = this;
+    return true;
+}
+
+bool Sphere::occluded(const Ray& ray, const double t_max) const
+{
+    double t;
+    return intersect(ray, glm::min(ray.t_max, t_max), t);
+}
+
+bool Sphere::intersect(const Ray& ray, const double t_max, double& t) const
+{
+    RenderStats::local().primitive_tests++;
+
     // O = ray.origin
     // D = ray.dir
     // R = this->radius
@@ -203,23 +323,42 @@ bool Sphere::intersect(const Ray& ray, Hit& hit) const
         const auto x1 = -0.5 * (b - root) / a;
         const auto x2 = -0.5 * (b + root) / a;
 
-        // The solution must be geq 0 because the intersection should be in front of the ray
-        // origin. Additionally we want the intersection location closer to the ray origin,
-        // hence the selected value must be the smaller one.
+        // The solution must be greater than t_min because the intersection should be in front
+        // of the ray origin. Additionally we want the intersection location closer to the ray
+        // origin, hence the selected value must be the smaller one.
         solution = glm::min(x1, x2);
-        if (solution <= 0) {
+        if (solution <= ray.t_min) {
             solution = glm::max(x1, x2);
-            if (solution <= 0) {
+            if (solution <= ray.t_min) {
                 return false; // both intersections are behind the ray origin
             }
         }
     }
 
-    hit.pos = ray.origin + solution * ray.dir;
+    if (solution <= ray.t_min || solution >= t_max) {
+        return false; // the intersection lies outside of the valid ray interval
+    }
+
+    t = solution;
+    return true;
+}
+
+void Sphere::finalize(const Ray& ray, Hit& hit) const
+{
+    hit.pos = ray.origin + hit.t * ray.dir;
     hit.normal = glm::normalize(hit.pos - center);
     hit.mat = material_;
     hit.uv = texMapping(hit.pos);
-    return true;
+}
+
+double Sphere::area() const { return 2 * glm::two_pi<double>() * radius * radius; }
+
+void Sphere::sample(const glm::dvec2& u, Hit& hit) const
+{
+    // a ray from the center which hits the surface at the sampled direction
+    hit.entity = this;
+    hit.t = radius;
+    finalize(Ray(center, randomOffset(u)), hit);
 }
 
 BoundingBox Sphere::boundingBox() const { return {center - radius, center + radius}; }
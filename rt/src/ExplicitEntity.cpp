@@ -17,6 +17,8 @@
 #include "ExplicitEntity.h"
 
 #include "ObjReader.h"
+#include "RenderStats.h"
+#include <algorithm>
 #include <ostream>
 #include <string>
 
@@ -25,7 +27,7 @@ ExplicitEntity::ExplicitEntity(std::vector<Triangle> faces)
 {
 }
 
-void ExplicitEntity::setMaterial(std::shared_ptr<Material> material)
+void ExplicitEntity::setMaterial(const Material* material)
 {
     this->material_ = material;
     for (auto& face : faces_) {
@@ -33,28 +35,48 @@ void ExplicitEntity::setMaterial(std::shared_ptr<Material> material)
     }
 }
 
+void ExplicitEntity::collectLights(std::vector<const Entity*>& lights) const
+{
+    for (const auto& face : faces_) {
+        face.collectLights(lights);
+    }
+}
+
 bool ExplicitEntity::intersect(const Ray& ray, Hit& hit) const
 {
     // TODO: check intersection direction (for triangles with only one side)
     // glm::dot(ray.direction, triangle.normal) > 0
 
     // quickly discard all rays that don't even intersect the bounding box
+    RenderStats::local().box_tests++;
     if (!boundingBox().intersect(ray)) {
         return false;
     }
 
-    auto min = std::numeric_limits<double>::infinity();
-    Hit tmp_hit;
+    // every hit shrinks the interval, so only closer triangles are reported afterwards
+    auto clipped = ray;
+    auto found = false;
     for (const auto& t : faces_) {
-        if (t.intersect(ray, tmp_hit)) {
-            const auto d = glm::distance(tmp_hit.pos, ray.origin);
-            if (d < min) {
-                min = d;
-                hit = tmp_hit;
-            }
+        if (t.intersect(clipped, hit)) {
+            clipped.t_max = hit.t;
+            found = true;
         }
     }
-    return min != std::numeric_limits<double>::infinity();
+    return found;
+}
+
+bool ExplicitEntity::occluded(const Ray& ray, const double t_max) const
+{
+    auto clipped = ray;
+    clipped.t_max = glm::min(ray.t_max, t_max);
+    RenderStats::local().box_tests++;
+    if (!boundingBox().intersect(clipped)) {
+        return false;
+    }
+
+    return std::any_of(faces_.begin(), faces_.end(), [&clipped](const Triangle& t) {
+        return t.occluded(clipped, clipped.t_max);
+    });
 }
 
 BoundingBox ExplicitEntity::boundingBox() const { return bbox_; }
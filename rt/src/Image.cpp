@@ -39,4 +39,13 @@ glm::dvec3 Image::getPixel(int x, int y) const
     return {qRed(p) / 255., qGreen(p) / 255., qBlue(p) / 255.};
 }
 
+Image Image::copy() const
+{
+    Image result(0, 0);
+    result._image = _image.copy();
+    return result;
+}
+
 void Image::clear() { _image.fill(Qt::black); }
+
+bool Image::save(const std::string& file) const { return _image.save(QString::fromStdString(file)); }
@@ -0,0 +1,72 @@
+/**
+ *    Copyright 2020 Jannik Bamberger
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "LightList.h"
+#include "Material.h"
+#include <algorithm>
+#include <numeric>
+#include <utility>
+
+LightList::LightList(std::vector<const Entity*> lights) : lights_(std::move(lights))
+{
+    std::vector<double> power;
+    power.reserve(lights_.size());
+    for (const auto* light : lights_) {
+        Hit center;
+        light->sample({0.5, 0.5}, center);
+        const auto emission = center.mat->emission(center.uv);
+        power.push_back(light->area() * (emission.r + emission.g + emission.b) / 3.0);
+    }
+
+    const auto total = std::accumulate(power.begin(), power.end(), 0.0);
+    if (total <= 0) {
+        // the emission does not tell the lights apart, fall back to a uniform selection
+        std::fill(power.begin(), power.end(), 1.0);
+    }
+
+    cdf_.resize(lights_.size());
+    std::partial_sum(power.begin(), power.end(), cdf_.begin());
+    const auto sum = cdf_.empty() ? 1.0 : cdf_.back();
+    for (size_t i = 0; i < lights_.size(); i++) {
+        cdf_[i] /= sum;
+        selection_[lights_[i]] += power[i] / sum;
+    }
+}
+
+bool LightList::empty() const { return lights_.empty(); }
+
+size_t LightList::size() const { return lights_.size(); }
+
+LightSample LightList::sample(const double u_select, const glm::dvec2& u_point) const
+{
+    const auto it = std::upper_bound(cdf_.begin(), cdf_.end(), u_select);
+    const auto index = std::min(static_cast<size_t>(it - cdf_.begin()), lights_.size() - 1);
+    const auto* light = lights_[index];
+
+    LightSample ls;
+    light->sample(u_point, ls.hit);
+    ls.pdf = pdf(light);
+    return ls;
+}
+
+double LightList::pdf(const Entity* light) const
+{
+    const auto it = selection_.find(light);
+    if (it == selection_.end()) {
+        return 0;
+    }
+    return it->second / light->area();
+}
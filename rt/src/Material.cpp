@@ -30,16 +30,45 @@ LambertianMaterial::LambertianMaterial(std::shared_ptr<Texture> tex) : tex_(std:
 
 bool LambertianMaterial::scatter(const Ray& in,
                                  const Hit& ir,
-                                 glm::dvec3& attenuation,
-                                 Ray& scatter_ray) const
+                                 Sampler& sampler,
+                                 ScatterRecord& rec) const
 {
+    const auto direction = hemisphere(ir.normal, in.dir, sampler.get2D());
+    rec.pdf = pdf(ir, in.dir, direction);
+    if (rec.pdf <= 0) {
+        return false; // grazing direction, it carries no light
+    }
 
-    const auto target = ir.pos + ir.normal + randomOffset();
-    scatter_ray = in.getChildRay(ir.pos, target - ir.pos);
-    attenuation = tex_->value(ir.uv);
+    const auto albedo = tex_->value(ir.uv);
+    rec.ray = in.getChildRay(ir.pos, direction);
+    rec.bsdf = albedo * glm::one_over_pi<double>();
+    // the cosine cancels out against the density
+    rec.attenuation = albedo;
+    rec.specular = false;
     return true;
 }
 
+glm::dvec3 LambertianMaterial::evaluate(const Hit& ir,
+                                        const glm::dvec3& wi,
+                                        const glm::dvec3& wo) const
+{
+    // only reflection on the side of the incoming ray
+    if (glm::dot(wi, ir.normal) * glm::dot(wo, ir.normal) >= 0) {
+        return glm::dvec3(0, 0, 0);
+    }
+    return tex_->value(ir.uv) * glm::one_over_pi<double>();
+}
+
+double LambertianMaterial::pdf(const Hit& ir, const glm::dvec3& wi, const glm::dvec3& wo) const
+{
+    const auto cos_i = glm::dot(wi, ir.normal);
+    const auto cos_o = glm::dot(wo, ir.normal);
+    if (cos_i * cos_o >= 0) {
+        return 0;
+    }
+    return std::abs(cos_o) * glm::one_over_pi<double>();
+}
+
 ///************************************************************************************************
 /// DiffuseLight
 ///************************************************************************************************
@@ -50,6 +79,8 @@ DiffuseLight::DiffuseLight(std::shared_ptr<Texture> tex) : LambertianMaterial(st
 
 glm::dvec3 DiffuseLight::emission(const glm::dvec2& uv) const { return tex_->value(uv); }
 
+bool DiffuseLight::isEmissive() const { return true; }
+
 ///************************************************************************************************
 /// Metal-like material
 ///************************************************************************************************
@@ -62,19 +93,23 @@ MetalLikeMaterial::MetalLikeMaterial(const glm::dvec3& attenuation, const double
 
 bool MetalLikeMaterial::scatter(const Ray& in,
                                 const Hit& ir,
-                                glm::dvec3& attenuation,
-                                Ray& scatter_ray) const
+                                Sampler& sampler,
+                                ScatterRecord& rec) const
 {
     // compute the reflection and then randomly offset the reflection based on the size of the
     // specular highlight.
-    const auto direction = glm::reflect(in.dir, ir.normal) + spec_size_ * randomOffset();
+    const auto offset = randomOffset(sampler.get2D());
+    const auto direction = glm::reflect(in.dir, ir.normal) + spec_size_ * offset;
 
-    scatter_ray = in.getChildRay(ir.pos, direction);
-    attenuation = attenuation_;
+    rec.ray = in.getChildRay(ir.pos, direction);
+    rec.bsdf = attenuation_;
+    rec.pdf = 0;
+    rec.attenuation = attenuation_;
+    rec.specular = true;
 
     // If the reflection does not point in the same direction as the normal it is not used.
     // In this case this are rays that are tangential to the surface.
-    return glm::dot(scatter_ray.dir, ir.normal) > 0;
+    return glm::dot(rec.ray.dir, ir.normal) > 0;
 }
 
 ///************************************************************************************************
@@ -100,8 +135,8 @@ Dielectric::Dielectric(const double refractive_index) : refractive_index_(refrac
 
 bool Dielectric::scatter(const Ray& in,
                          const Hit& ir,
-                         glm::dvec3& attenuation,
-                         Ray& scatter_ray) const
+                         Sampler& sampler,
+                         ScatterRecord& rec) const
 {
 
     glm::dvec3 n;
@@ -141,15 +176,18 @@ bool Dielectric::scatter(const Ray& in,
         // const auto ref_prb = reflectance_fresnel(n1, n2, cosI, cosT);
 
         // randomly decide if the ray should reflect or refract based on computed probability
-        if (rng() >= ref_prb) {
+        if (sampler.get1D() >= ref_prb) {
             // the ray is refracted, compute the refraction direction
             out_direction = eta * (in.dir - n * dt) - n * cosT;
         }
     }
 
     // All light is either reflected or refracted, no attenuation takes place.
-    attenuation = glm::dvec3(1, 1, 1);
-    scatter_ray = in.getChildRay(ir.pos, out_direction);
+    rec.ray = in.getChildRay(ir.pos, out_direction);
+    rec.bsdf = glm::dvec3(1, 1, 1);
+    rec.pdf = 0;
+    rec.attenuation = glm::dvec3(1, 1, 1);
+    rec.specular = true;
 
     return true; // The ray is never absorbed in a dielectric material.
 }
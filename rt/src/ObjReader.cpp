@@ -90,6 +90,7 @@ ObjContent makeSphere(const glm::dvec3 center,
         const auto success = s.intersect(r, hit);
 
         assert(success);
+        hit.finalize(r);
         return hit.pos;
     };
 
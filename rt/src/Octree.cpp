@@ -16,6 +16,10 @@
 
 #include "Octree.h"
 
+#include "RayPacket.h"
+#include "RenderStats.h"
+#include <algorithm>
+
 class Octree::Node : public Hittable {
     BoundingBox bbox_;
     std::vector<Hittable*> entities_;
@@ -144,40 +148,154 @@ class Octree::Node : public Hittable {
 
     bool intersect(const Ray& ray, Hit& hit) const override
     {
-        auto min_dist = std::numeric_limits<double>::max();
+
+        // every entity and child is tested against its bounding box
+        auto& stats = RenderStats::local();
+        stats.octree_nodes++;
+        stats.box_tests += entities_.size() + (isLeaf() ? 0 : children_.size());
+
+        // The interval of the ray is clipped to the closest hit. Children beyond it are skipped.
+        auto clipped = ray;
+        auto found = false;
         for (const auto& e : entities_) {
-            Hit tmp_hit;
-            if (!e->boundingBox().intersect(ray)) {
+            if (!e->boundingBox().intersect(clipped)) {
                 continue;
             }
-            if (!e->intersect(ray, tmp_hit)) {
-                continue;
-            }
-            const auto tmp_dist = glm::distance(tmp_hit.pos, ray.origin);
-            if (tmp_dist < min_dist) {
-                hit = tmp_hit;
-                min_dist = tmp_dist;
+            if (e->intersect(clipped, hit)) {
+                clipped.t_max = hit.t;
+                found = true;
             }
         }
 
         if (!isLeaf()) {
+            // visit the children ordered by the distance at which the ray enters them, insertion
+            // sort of the at most eight entered children
+            std::array<std::pair<double, const Node*>, 8> order;
+            size_t count = 0;
             for (const auto& c : children_) {
-                if (!c->bbox_.intersect(ray)) {
+                double entry;
+                if (!c->bbox_.intersect(clipped, entry)) {
                     continue;
                 }
-                Hit tmp_hit;
-                if (!c->intersect(ray, tmp_hit)) {
+                auto j = count++;
+                for (; j > 0 && order[j - 1].first > entry; j--) {
+                    order[j] = order[j - 1];
+                }
+                order[j] = {entry, c.get()};
+            }
+
+            for (size_t i = 0; i < count && order[i].first <= clipped.t_max; i++) {
+                if (order[i].second->intersect(clipped, hit)) {
+                    clipped.t_max = hit.t;
+                    found = true;
+                }
+            }
+        }
+
+        return found;
+    }
+
+    void intersectPacket(RayPacket& packet, const uint64_t active) const override
+    {
+        auto& stats = RenderStats::local();
+        stats.octree_nodes++;
+
+        // Boxes which the interval bounds of the rays miss are skipped without testing the rays.
+        const RayInterval<double> interval(packet.rays.data(), active);
+        const auto entered = [&](const BoundingBox& bbox, double* entry) {
+            stats.box_tests++;
+            uint64_t mask = 0;
+            double bound;
+            if (!interval.mayIntersect(bbox.min, bbox.max, bound)) {
+                return mask;
+            }
+            for (size_t i = 0; i < packet.size; i++) {
+                if ((active >> i & 1) == 0) {
                     continue;
                 }
-                const auto tmp_dist = glm::distance(tmp_hit.pos, ray.origin);
-                if (tmp_dist < min_dist) {
-                    hit = tmp_hit;
-                    min_dist = tmp_dist;
+                stats.box_tests++;
+                double t;
+                if (bbox.intersect(packet.rays[i], t)) {
+                    mask |= 1ull << i;
+                    if (entry != nullptr) {
+                        entry[i] = t;
+                    }
+                }
+            }
+            return mask;
+        };
+
+        for (const auto& e : entities_) {
+            const auto mask = entered(e->boundingBox(), nullptr);
+            if (mask != 0) {
+                e->intersectPacket(packet, mask);
+            }
+        }
+        if (isLeaf()) {
+            return;
+        }
+
+        // Visit the children ordered by the smallest distance at which a ray enters them,
+        // insertion sort of the at most eight entered children. Only the rays which enter a child
+        // have an entry distance, the others are excluded by its mask.
+        std::array<std::array<double, RayPacket::max_size>, 8> entries;
+        std::array<uint64_t, 8> entered_mask{};
+        std::array<std::pair<double, size_t>, 8> order;
+        size_t count = 0;
+        for (size_t c = 0; c < children_.size(); c++) {
+            entries[c].fill(std::numeric_limits<double>::infinity());
+            entered_mask[c] = entered(children_[c]->bbox_, entries[c].data());
+            if (entered_mask[c] == 0) {
+                continue;
+            }
+            auto nearest = std::numeric_limits<double>::infinity();
+            for (size_t i = 0; i < packet.size; i++) {
+                if ((entered_mask[c] >> i & 1) != 0) {
+                    nearest = std::min(nearest, entries[c][i]);
+                }
+            }
+            auto j = count++;
+            for (; j > 0 && order[j - 1].first > nearest; j--) {
+                order[j] = order[j - 1];
+            }
+            order[j] = {nearest, c};
+        }
+
+        for (size_t k = 0; k < count; k++) {
+            const auto c = order[k].second;
+            uint64_t mask = 0;
+            for (size_t i = 0; i < packet.size; i++) {
+                if ((entered_mask[c] >> i & 1) != 0 && entries[c][i] <= packet.rays[i].t_max) {
+                    mask |= 1ull << i;
                 }
             }
+            if (mask != 0) {
+                children_[c]->intersectPacket(packet, mask);
+            }
         }
+    }
 
-        return min_dist < std::numeric_limits<double>::max();
+    [[nodiscard]] bool occluded(const Ray& ray, const double t_max) const override
+    {
+        auto& stats = RenderStats::local();
+        stats.octree_nodes++;
+        stats.box_tests += entities_.size();
+
+        for (const auto& e : entities_) {
+            if (e->boundingBox().intersect(ray) && e->occluded(ray, t_max)) {
+                return true;
+            }
+        }
+        if (isLeaf()) {
+            return false;
+        }
+        for (const auto& c : children_) {
+            stats.box_tests++;
+            if (c->bbox_.intersect(ray) && c->occluded(ray, t_max)) {
+                return true;
+            }
+        }
+        return false;
     }
 
     [[nodiscard]] BoundingBox boundingBox() const override { return bbox_; }
@@ -202,10 +320,26 @@ Octree::Octree(const glm::dvec3 min, const glm::dvec3 max)
 {
 }
 
+Octree::~Octree() = default;
+
 void Octree::insert(Hittable* object) const { root_->insert(object, 0); }
 
 bool Octree::intersect(const Ray& ray, Hit& hit) const { return root_->intersect(ray, hit); }
 
+void Octree::intersectPacket(RayPacket& packet, const uint64_t active) const
+{
+    if (active != 0) {
+        root_->intersectPacket(packet, active);
+    }
+}
+
+bool Octree::occluded(const Ray& ray, const double t_max) const
+{
+    auto clipped = ray;
+    clipped.t_max = glm::min(ray.t_max, t_max);
+    return root_->occluded(clipped, clipped.t_max);
+}
+
 BoundingBox Octree::boundingBox() const { return root_->boundingBox(); }
 
 std::ostream& operator<<(std::ostream& o, const Octree& t) { return o << "{" << *t.root_ << "}"; }
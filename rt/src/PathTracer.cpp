@@ -16,105 +16,497 @@
 
 #include "PathTracer.h"
 #include "Material.h"
+#include "RayPacket.h"
 #include "entities.h"
+#include <algorithm>
 #include <chrono>
+#include <cmath>
 #include <iostream>
+#include <memory>
+#include <numeric>
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+namespace {
+/// Added to the luminance in the relative error, such that dark pixels converge in finite time.
+constexpr double dark_offset = 1e-2;
+
+double luminance(const glm::dvec3& c) { return 0.2126 * c.r + 0.7152 * c.g + 0.0722 * c.b; }
+} // namespace
+
+PathTracer::Accumulator::Accumulator(const size_t pixels)
+    : sum(pixels, glm::dvec3(0, 0, 0)), sum_sq(pixels, 0.0), count(pixels, 0), active(pixels, 1)
+{
+}
 
 PathTracer::PathTracer(const Camera& camera, std::shared_ptr<const Octree> scene)
     : samples_(2048), camera_(camera), scene_(std::move(scene)),
-      image_(std::make_shared<Image>(0, 0))
+      lights_(std::make_shared<LightList>()), image_(std::make_shared<Image>(0, 0))
 {
 }
 
 void PathTracer::setScene(std::shared_ptr<const Octree> scene) { scene_ = std::move(scene); }
 
+void PathTracer::setLights(std::shared_ptr<const LightList> lights)
+{
+    lights_ = lights ? std::move(lights) : std::make_shared<LightList>();
+}
+
 void PathTracer::setSampleCount(const size_t samples) { samples_ = samples; }
 
+void PathTracer::setThreadCount(const int threads) { threads_ = threads; }
+
+void PathTracer::setBounceLimits(const int min_bounces, const int max_bounces)
+{
+    max_bounces_ = std::max(max_bounces, 1);
+    min_bounces_ = std::clamp(min_bounces, 0, max_bounces_);
+}
+
+void PathTracer::setAdaptive(const double threshold, const size_t min_samples)
+{
+    adaptive_threshold_ = std::max(threshold, 0.0);
+    adaptive_min_samples_ = std::max<size_t>(min_samples, 2);
+}
+
+void PathTracer::setTimeBudget(const double seconds) { time_budget_ = std::max(seconds, 0.0); }
+
+void PathTracer::setErrorTarget(const double error) { error_target_ = std::max(error, 0.0); }
+
+void PathTracer::setPacketTracing(const bool enabled) { packets_ = enabled; }
+
+void PathTracer::setSampler(const SamplerType type) { sampler_type_ = type; }
+
+void PathTracer::setSeed(const uint64_t seed)
+{
+    seeded_ = true;
+    seed_ = seed;
+}
+
 void PathTracer::run(const int w, const int h)
 {
     const auto samples = samples_;
+    const auto threads = threadCount();
+    const auto tiles = makeTiles(w, h);
+    const auto pixels = static_cast<size_t>(w) * h;
+    const auto adaptive = adaptive_threshold_ > 0;
+    // a time budget or an error target replace the sample count
+    const auto open_ended = time_budget_ > 0 || error_target_ > 0;
+    const auto max_samples = open_ended ? max_open_samples_
+                                        : adaptive ? samples * adaptive_max_factor_ : samples;
 
-    std::vector<glm::dvec3> buffer;
-    buffer.reserve(w * h);
-    for (auto i = 0; i < w * h; i++) {
-        buffer.emplace_back(0, 0, 0);
-    }
+    // Every tile only touches its own pixels of the accumulator, hence it needs no lock. Only the
+    // shared image is written under image_mutex_.
+    accumulator_ = Accumulator(pixels);
 
-    image_ = std::make_shared<Image>(w, h);
+    frame_seed_ = seed_;
+    if (!seeded_) {
+        frame_seed_ = std::chrono::system_clock::now().time_since_epoch().count();
+    }
+    width_ = w;
+    height_ = h;
+    {
+        std::lock_guard<std::mutex> lock(image_mutex_);
+        image_ = std::make_shared<Image>(w, h);
+    }
     camera_.setWindowSize(w, h);
-    // The structure of the for loop should remain for incremental rendering.
-    for (auto s = 1; s <= samples; ++s) {
+    {
+        std::lock_guard<std::mutex> lock(stats_mutex_);
+        stats_ = RenderStats();
+        progress_ = Progress();
+    }
+
+    using namespace std::chrono;
+    const auto start = steady_clock::now();
+    // time to trace one sample of one pixel, measured in the last pass
+    auto sample_seconds = 0.0;
+
+    // The passes remain for incremental rendering. Small passes at the beginning produce a quick
+    // preview, later passes amortize the publishing of the tiles over more samples.
+    // All active pixels receive the same samples in a pass, hence they share the sample count
+    // done. Converged pixels drop out and leave the rest of the budget to the active ones.
+    size_t pass_samples = 1;
+    auto budget = pixels * (open_ended ? max_samples : samples);
+    auto active = pixels;
+    for (size_t done = 0; done < max_samples && active > 0;) {
         if (!running_) {
             return;
         }
-        std::cout << "Sample " << s << std::endl;
-#pragma omp parallel for schedule(dynamic, 1)
-        for (auto y = 0; y < h; ++y) {
-            for (auto x = 0; x < w; ++x) {
-                if (running_) {
-                    const auto color = computePixel(x, y);
-#pragma omp critical
-                    {
-                        const auto pos = x * h + y;
-                        buffer[pos] += color;
-                        const auto pix = buffer[pos] / static_cast<double>(s);
-                        image_->setPixel(x, y, glm::clamp(pix, 0.0, 1.0));
+        auto count = std::min({pass_samples, max_samples - done, budget / active});
+        if ((adaptive || error_target_ > 0) && done < adaptive_min_samples_) {
+            // end a pass at the minimum sample count, such that the first test happens there
+            count = std::min(count, adaptive_min_samples_ - done);
+        }
+        if (time_budget_ > 0 && sample_seconds > 0) {
+            // shrink the pass, such that it ends before the deadline
+            const auto elapsed = duration<double>(steady_clock::now() - start).count();
+            const auto remaining = std::max(time_budget_ - elapsed, 0.0);
+            count = std::min(count, static_cast<size_t>(remaining / (sample_seconds * active)));
+        }
+        if (count == 0) {
+            break;
+        }
+        const auto total = done + count;
+        const auto pass_start = steady_clock::now();
+#pragma omp parallel for schedule(dynamic, 1) num_threads(threads)
+        for (auto t = 0; t < static_cast<int>(tiles.size()); ++t) {
+            static_cast<void>(renderTile(tiles[t], count, total));
+        }
+        if (!running_) {
+            return; // the pass is incomplete
+        }
+        const auto pass_end = steady_clock::now();
+        sample_seconds = duration<double>(pass_end - pass_start).count() / (count * active);
+        budget -= count * active;
+        done = total;
+
+        const auto error = pixelErrors();
+        const auto n = static_cast<double>(std::max<size_t>(pixels, 1));
+        const auto frame_error = std::accumulate(error.begin(), error.end(), 0.0) / n;
+        {
+            std::lock_guard<std::mutex> lock(stats_mutex_);
+            const auto& counts = accumulator_.count;
+            progress_.samples_per_pixel = std::accumulate(counts.begin(), counts.end(), 0.0) / n;
+            progress_.error = frame_error;
+            progress_.seconds = duration<double>(pass_end - start).count();
+        }
+        if (adaptive && done >= adaptive_min_samples_) {
+            active = updateActivePixels(w, h, error);
+        }
+        pass_samples = std::min(2 * pass_samples, max_pass_samples_);
+        std::cout << "Sample " << done << std::endl;
+
+        if (error_target_ > 0 && done >= adaptive_min_samples_ && frame_error <= error_target_) {
+            break;
+        }
+    }
+}
+
+int PathTracer::threadCount() const
+{
+#ifdef _OPENMP
+    return threads_ > 0 ? threads_ : omp_get_max_threads();
+#else
+    return 1;
+#endif
+}
+
+std::vector<PathTracer::Tile> PathTracer::makeTiles(const int w, const int h)
+{
+    std::vector<Tile> tiles;
+    for (auto y = 0; y < h; y += tile_size_) {
+        for (auto x = 0; x < w; x += tile_size_) {
+            tiles.push_back({x, y, std::min(x + tile_size_, w), std::min(y + tile_size_, h)});
+        }
+    }
+    return tiles;
+}
+
+std::vector<double> PathTracer::pixelErrors() const
+{
+    const auto& acc = accumulator_;
+    std::vector<double> error(acc.count.size(), std::numeric_limits<double>::infinity());
+    for (size_t i = 0; i < error.size(); ++i) {
+        const double n = acc.count[i];
+        if (n < 2) {
+            continue;
+        }
+        const auto mean = luminance(acc.sum[i]) / n;
+        const auto variance = std::max(acc.sum_sq[i] / n - mean * mean, 0.0) * n / (n - 1);
+        error[i] = std::sqrt(variance / n) / (mean + dark_offset);
+    }
+    return error;
+}
+
+size_t PathTracer::updateActivePixels(const int w, const int h, const std::vector<double>& error)
+{
+    auto& acc = accumulator_;
+
+    // A single pixel may look converged by chance, e.g. if all samples missed a caustic. The
+    // neighbourhood keeps such pixels active as long as the region around them is noisy.
+    size_t active = 0;
+    for (auto y = 0; y < h; ++y) {
+        for (auto x = 0; x < w; ++x) {
+            const auto i = static_cast<size_t>(y) * w + x;
+            if (!acc.active[i]) {
+                continue;
+            }
+            auto max_error = 0.0;
+            for (auto ny = std::max(y - 1, 0); ny <= std::min(y + 1, h - 1); ++ny) {
+                for (auto nx = std::max(x - 1, 0); nx <= std::min(x + 1, w - 1); ++nx) {
+                    max_error = std::max(max_error, error[static_cast<size_t>(ny) * w + nx]);
+                }
+            }
+            acc.active[i] = max_error >= adaptive_threshold_;
+            active += acc.active[i];
+        }
+    }
+    return active;
+}
+
+bool PathTracer::renderTile(const Tile& tile, const size_t samples, const size_t total)
+{
+    const auto tile_w = tile.x1 - tile.x0;
+    const auto image_w = width_;
+    const auto first_sample = total - samples;
+    const auto sampler = makeSampler(sampler_type_, frame_seed_, samples_);
+
+    // the thread-local counters only record this tile and are merged into the frame afterwards
+    auto& local_stats = RenderStats::local();
+    local_stats = RenderStats();
+    const auto merge_stats = [this, &local_stats]() {
+        std::lock_guard<std::mutex> lock(stats_mutex_);
+        stats_ += local_stats;
+    };
+
+    auto& acc = accumulator_;
+    const auto local_size = static_cast<size_t>(tile_w) * (tile.y1 - tile.y0);
+    std::vector<glm::dvec3> local(local_size, glm::dvec3(0, 0, 0));
+    std::vector<double> local_sq(local_size, 0.0);
+    const auto add_sample = [&](const int x, const int y, const glm::dvec3& c) {
+        const auto l = (y - tile.y0) * tile_w + (x - tile.x0);
+        local[l] += c;
+        local_sq[l] += luminance(c) * luminance(c);
+    };
+
+    const auto block = packets_ ? packet_size_ : 1;
+    const auto packet = packets_ ? std::make_unique<RayPacket>() : nullptr;
+    // one sampler per ray of a packet, each path continues with the state after its camera ray
+    std::vector<std::unique_ptr<Sampler>> packet_samplers;
+    if (packets_) {
+        for (auto i = 0; i < packet_size_ * packet_size_; ++i) {
+            packet_samplers.push_back(makeSampler(sampler_type_, frame_seed_, samples_));
+        }
+    }
+    for (auto by = tile.y0; by < tile.y1; by += block) {
+        for (auto bx = tile.x0; bx < tile.x1; bx += block) {
+            const auto bx1 = std::min(bx + block, tile.x1);
+            const auto by1 = std::min(by + block, tile.y1);
+            for (size_t s = 0; s < samples; ++s) {
+                if (!running_) {
+                    merge_stats();
+                    return false; // discard the partial tile, it would bias the image
+                }
+                if (!packet) {
+                    const auto pixel = static_cast<uint64_t>(by) * image_w + bx;
+                    if (!acc.active[pixel]) {
+                        break;
                     }
+                    sampler->startSample(pixel, first_sample + s);
+                    add_sample(bx, by, computePixel(bx, by, *sampler));
+                    continue;
+                }
+
+                // Trace the primary rays of the block together. Every path is continued on its
+                // own afterwards with the sampler which generated its camera ray.
+                packet->clear();
+                for (auto y = by; y < by1; ++y) {
+                    for (auto x = bx; x < bx1; ++x) {
+                        const auto pixel = static_cast<uint64_t>(y) * image_w + x;
+                        if (acc.active[pixel]) {
+                            auto& ray_sampler = *packet_samplers[packet->size];
+                            ray_sampler.startSample(pixel, first_sample + s);
+                            packet->add(camera_.getRay(x, y, ray_sampler));
+                        }
+                    }
+                }
+                if (packet->size == 0) {
+                    break;
+                }
+                scene_->intersectPacket(*packet, packet->all());
+
+                size_t k = 0;
+                for (auto y = by; y < by1; ++y) {
+                    for (auto x = bx; x < bx1; ++x) {
+                        const auto pixel = static_cast<uint64_t>(y) * image_w + x;
+                        if (!acc.active[pixel]) {
+                            continue;
+                        }
+                        // the traversal clipped the interval to the hit, camera rays are unbounded
+                        auto ray = packet->rays[k];
+                        ray.t_max = std::numeric_limits<double>::infinity();
+                        const auto found = (packet->found >> k & 1) != 0;
+                        add_sample(x, y,
+                                   tracePath(ray, packet->hits[k], found, *packet_samplers[k]));
+                        k++;
+                    }
+                }
+            }
+        }
+    }
+
+    // accumulate the tile, the colors are written to the image at once afterwards
+    for (auto y = tile.y0; y < tile.y1; ++y) {
+        for (auto x = tile.x0; x < tile.x1; ++x) {
+            const auto i = static_cast<size_t>(y) * image_w + x;
+            if (!acc.active[i]) {
+                continue;
+            }
+            const auto l = (y - tile.y0) * tile_w + (x - tile.x0);
+            acc.sum[i] += local[l];
+            acc.sum_sq[i] += local_sq[l];
+            acc.count[i] = static_cast<uint32_t>(total);
+            local[l] = glm::clamp(acc.sum[i] / static_cast<double>(total), 0.0, 1.0);
+        }
+    }
+
+    // publish the tile
+    {
+        std::lock_guard<std::mutex> lock(image_mutex_);
+        for (auto y = tile.y0; y < tile.y1; ++y) {
+            for (auto x = tile.x0; x < tile.x1; ++x) {
+                const auto i = static_cast<size_t>(y) * image_w + x;
+                if (acc.active[i]) {
+                    image_->setPixel(x, y, local[(y - tile.y0) * tile_w + (x - tile.x0)]);
                 }
             }
         }
     }
+    merge_stats();
+    return true;
 }
 
-glm::dvec3 PathTracer::computePixel(const int x, const int y) const
+glm::dvec3 PathTracer::computePixel(const int x, const int y, Sampler& sampler) const
 {
-    constexpr auto max_bounces = 5;
+    const auto ray = camera_.getRay(x, y, sampler);
+    Hit hit;
+    const auto found = scene_->intersect(ray, hit);
+    return tracePath(ray, hit, found, sampler);
+}
 
-    // the currently active ray
-    auto ray = camera_.getRay(x, y);
+glm::dvec3 PathTracer::tracePath(Ray ray, Hit hit, bool found, Sampler& sampler) const
+{
     // the total amount of light carried over this path
     auto light = glm::dvec3(0, 0, 0);
     // value gives the amount of light that is carried per color channel over the path
     auto throughput = glm::dvec3(1, 1, 1);
+    // density of the direction of the current ray if it was sampled from a non-specular BSDF. A
+    // light source found by such a ray was also reachable by the light sampling of the last hit.
+    auto bsdf_pdf = 0.0;
 
-    for (auto i = 0; i < max_bounces; i++) {
-        Hit hit;
-        if (!scene_->intersect(ray, hit)) {
-            break; // the ray didn't hit anything -> no contribution.
+    auto& stats = RenderStats::local();
+    for (auto i = 0; i < max_bounces_; i++) {
+        stats.addRay(i);
+        if (i > 0) {
+            // the closest hit of the primary ray is given, the bounces are traced here
+            hit = Hit();
+            found = scene_->intersect(ray, hit);
         }
+        if (!found) {
+            stats.paths_escaped++;
+            return light; // the ray didn't hit anything -> no contribution.
+        }
+        hit.finalize(ray);
 
         // add light reduced by combined attenuation
-        light += throughput * hit.mat->emission(hit.uv);
+        const auto emission = hit.mat->emission(hit.uv);
+        if (emission != glm::dvec3(0, 0, 0)) {
+            auto weight = 1.0;
+            const auto cos_light = glm::abs(glm::dot(hit.normal, ray.dir));
+            if (bsdf_pdf > 0 && cos_light > 0) {
+                // convert the area density of the light sampling to solid angle
+                const auto light_pdf = lights_->pdf(hit.entity) * hit.t * hit.t / cos_light;
+                weight = powerHeuristic(bsdf_pdf, light_pdf);
+            }
+            light += weight * throughput * emission;
+        }
+
+        ScatterRecord rec;
+        if (!hit.mat->scatter(ray, hit, sampler, rec)) {
+            stats.paths_absorbed++;
+            return light; // the ray did not scatter -> no further contribution
+        }
+
+        // the light found by the shadow ray belongs to the next bounce, which must not exceed the
+        // maximum path length either
+        if (!rec.specular && !lights_->empty() && i + 1 < max_bounces_) {
+            light += throughput * sampleLight(ray, hit, sampler);
+        }
+
+        ray = rec.ray;
+        throughput *= rec.attenuation;
+        bsdf_pdf = rec.specular ? 0.0 : rec.pdf;
 
-        glm::dvec3 bounce_attenuation;
-        auto scatter_ray(ray);
-        if (!hit.mat->scatter(ray, hit, bounce_attenuation, scatter_ray)) {
-            break; // the ray did not scatter -> no further contribution
+        // russian roulette: paths which carry little light are likely terminated, the survivors
+        // are weighted up by the inverse survival probability
+        if (i + 1 >= min_bounces_ && i + 1 < max_bounces_) {
+            const auto survival =
+                glm::min(glm::max(throughput.r, glm::max(throughput.g, throughput.b)), 0.95);
+            if (sampler.get1D() >= survival) {
+                stats.paths_roulette++;
+                return light;
+            }
+            throughput /= survival;
         }
-        ray = scatter_ray;
-        throughput *= bounce_attenuation;
     }
 
+    stats.paths_max_depth++;
     return light;
 }
 
-glm::dvec3 PathTracer::computePixel(const Ray& ray) const
+glm::dvec3 PathTracer::sampleLight(const Ray& ray, const Hit& hit, Sampler& sampler) const
 {
+    const auto u_select = sampler.get1D();
+    const auto ls = lights_->sample(u_select, sampler.get2D());
+
+    const auto to_light = ls.hit.pos - hit.pos;
+    const auto dist = glm::length(to_light);
+    const auto wo = to_light / dist;
+    const auto cos_light = glm::abs(glm::dot(ls.hit.normal, wo));
+    if (ls.pdf <= 0 || cos_light <= 0) {
+        return {0, 0, 0};
+    }
+
+    const auto f = hit.mat->evaluate(hit, ray.dir, wo);
+    const auto emission = ls.hit.mat->emission(ls.hit.uv);
+    if (f == glm::dvec3(0, 0, 0) || emission == glm::dvec3(0, 0, 0)) {
+        return {0, 0, 0}; // the light is behind the surface, no shadow ray needed
+    }
+
+    // the interval ends just before the light, such that it does not occlude itself
+    const auto shadow = ray.getChildRay(hit.pos, wo);
+    RenderStats::local().shadow_rays++;
+    if (scene_->occluded(shadow, dist * (1 - 1e-6))) {
+        return {0, 0, 0};
+    }
+
+    const auto light_pdf = ls.pdf * dist * dist / cos_light; // with respect to solid angle
+    const auto weight = powerHeuristic(light_pdf, hit.mat->pdf(hit, ray.dir, wo));
+    return weight * f * glm::abs(glm::dot(hit.normal, wo)) * emission / light_pdf;
+}
+
+double PathTracer::powerHeuristic(const double pdf_a, const double pdf_b)
+{
+    const auto a2 = pdf_a * pdf_a;
+    return a2 / (a2 + pdf_b * pdf_b);
+}
+
+glm::dvec3 PathTracer::computePixel(const Ray& ray, Sampler& sampler) const
+{
+    auto& stats = RenderStats::local();
+    stats.addRay(ray.child_level);
+
     Hit hit;
     if (!scene_->intersect(ray, hit)) {
+        stats.paths_escaped++;
         return {0, 0, 0};
     }
+    hit.finalize(ray);
 
     const auto light = hit.mat->emission(hit.uv);
 
-    if (ray.child_level <= 5) {
-        glm::dvec3 attenuation;
-        auto scatter_ray(ray);
-        if (hit.mat->scatter(ray, hit, attenuation, scatter_ray)) {
-            return light + attenuation * computePixel(scatter_ray);
-        }
+    if (ray.child_level > 5) {
+        stats.paths_max_depth++;
+        return light;
     }
 
+    ScatterRecord rec;
+    if (hit.mat->scatter(ray, hit, sampler, rec)) {
+        return light + rec.attenuation * computePixel(rec.ray, sampler);
+    }
+
+    stats.paths_absorbed++;
     return light;
 }
 
@@ -124,4 +516,40 @@ void PathTracer::stop() { running_ = false; }
 
 void PathTracer::start() { running_ = true; }
 
-std::shared_ptr<Image> PathTracer::getImage() const { return image_; }
+std::shared_ptr<Image> PathTracer::getImage() const
+{
+    std::lock_guard<std::mutex> lock(image_mutex_);
+    return std::make_shared<Image>(image_->copy());
+}
+
+RenderStats PathTracer::getStats() const
+{
+    std::lock_guard<std::mutex> lock(stats_mutex_);
+    return stats_;
+}
+
+PathTracer::Progress PathTracer::getProgress() const
+{
+    std::lock_guard<std::mutex> lock(stats_mutex_);
+    return progress_;
+}
+
+std::shared_ptr<Image> PathTracer::getSampleHeatmap() const
+{
+    const auto w = width_;
+    const auto h = height_;
+    auto heatmap = std::make_shared<Image>(w, h);
+    const auto& count = accumulator_.count;
+    if (count.size() != static_cast<size_t>(w) * h || count.empty()) {
+        return heatmap;
+    }
+
+    const double max_count = std::max(*std::max_element(count.begin(), count.end()), 1u);
+    for (auto y = 0; y < h; ++y) {
+        for (auto x = 0; x < w; ++x) {
+            const auto t = count[static_cast<size_t>(y) * w + x] / max_count;
+            heatmap->setPixel(x, y, glm::clamp(glm::dvec3(3 * t, 3 * t - 1, 3 * t - 2), 0.0, 1.0));
+        }
+    }
+    return heatmap;
+}
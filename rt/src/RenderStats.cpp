@@ -0,0 +1,92 @@
+/**
+ *    Copyright 2020 Jannik Bamberger
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "RenderStats.h"
+
+#include <iomanip>
+#include <numeric>
+#include <sstream>
+
+uint64_t RenderStats::rayCount() const
+{
+    return std::accumulate(rays.begin(), rays.end(), shadow_rays);
+}
+
+uint64_t RenderStats::pathCount() const
+{
+    return paths_escaped + paths_absorbed + paths_max_depth + paths_roulette;
+}
+
+double RenderStats::averagePathLength() const
+{
+    const auto segments = rayCount() - shadow_rays;
+    return static_cast<double>(segments) / static_cast<double>(std::max<uint64_t>(pathCount(), 1));
+}
+
+RenderStats& RenderStats::operator+=(const RenderStats& other)
+{
+    for (size_t i = 0; i < depth_buckets; i++) {
+        rays[i] += other.rays[i];
+    }
+    shadow_rays += other.shadow_rays;
+    bvh_nodes += other.bvh_nodes;
+    octree_nodes += other.octree_nodes;
+    box_tests += other.box_tests;
+    primitive_tests += other.primitive_tests;
+    paths_escaped += other.paths_escaped;
+    paths_absorbed += other.paths_absorbed;
+    paths_max_depth += other.paths_max_depth;
+    paths_roulette += other.paths_roulette;
+    return *this;
+}
+
+std::string RenderStats::summary() const
+{
+    const auto ray_count = static_cast<double>(std::max<uint64_t>(rayCount(), 1));
+    const auto per_ray = [ray_count](uint64_t value) {
+        return static_cast<double>(value) / ray_count;
+    };
+
+    std::ostringstream os;
+    os << std::fixed << std::setprecision(2) << static_cast<double>(rayCount()) / 1e6
+       << " M rays | nodes/ray " << per_ray(bvh_nodes + octree_nodes) << " | boxes/ray "
+       << per_ray(box_tests) << " | prims/ray " << per_ray(primitive_tests) << " | path length "
+       << averagePathLength();
+    return os.str();
+}
+
+void RenderStats::writeJson(std::ostream& os, const std::string& indent) const
+{
+    const auto in = indent + "  ";
+    os << "{\n" << in << "\"rays\": " << rayCount() << ",\n" << in << "\"rays_by_depth\": [";
+    for (size_t i = 0; i < depth_buckets; i++) {
+        os << (i > 0 ? ", " : "") << rays[i];
+    }
+    os << "],\n"
+       << in << "\"shadow_rays\": " << shadow_rays << ",\n"
+       << in << "\"bvh_nodes\": " << bvh_nodes << ",\n"
+       << in << "\"octree_nodes\": " << octree_nodes << ",\n"
+       << in << "\"box_tests\": " << box_tests << ",\n"
+       << in << "\"primitive_tests\": " << primitive_tests << ",\n"
+       << in << "\"paths\": {\n"
+       << in << "  \"escaped\": " << paths_escaped << ",\n"
+       << in << "  \"absorbed\": " << paths_absorbed << ",\n"
+       << in << "  \"max_depth\": " << paths_max_depth << ",\n"
+       << in << "  \"roulette\": " << paths_roulette << ",\n"
+       << in << "  \"average_length\": " << averagePathLength() << "\n"
+       << in << "}\n"
+       << indent << "}";
+}
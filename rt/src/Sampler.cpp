@@ -0,0 +1,341 @@
+/**
+ *    Copyright 2020 Jannik Bamberger
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "Sampler.h"
+#include "RandomUtils.h"
+#include <algorithm>
+#include <array>
+#include <cmath>
+
+namespace {
+
+/**
+ * Combines two keys into a 32 bit hash value.
+ */
+uint32_t hash(const uint64_t a, const uint64_t b)
+{
+    return static_cast<uint32_t>(mixBits(a ^ mixBits(b)) >> 32U);
+}
+
+/**
+ * Maps a 32 bit fixed point number to [0, 1).
+ */
+double toUnit(const uint32_t x) { return x * 0x1p-32; }
+
+/**
+ * Random permutation of [0, l) selected by p without any table, by Kensler (2013).
+ */
+uint32_t permute(uint32_t i, const uint32_t l, const uint32_t p)
+{
+    auto w = l - 1;
+    w |= w >> 1U;
+    w |= w >> 2U;
+    w |= w >> 4U;
+    w |= w >> 8U;
+    w |= w >> 16U;
+    // cycle walking: repeat until the value falls into the range
+    do {
+        i ^= p;
+        i *= 0xe170893dU;
+        i ^= p >> 16U;
+        i ^= (i & w) >> 4U;
+        i ^= p >> 8U;
+        i *= 0x0929eb3fU;
+        i ^= p >> 23U;
+        i ^= (i & w) >> 1U;
+        i *= 1U | p >> 27U;
+        i *= 0x6935fa69U;
+        i ^= (i & w) >> 11U;
+        i *= 0x74dcb303U;
+        i ^= (i & w) >> 2U;
+        i *= 0x9e501cc3U;
+        i ^= (i & w) >> 2U;
+        i *= 0xc860a3dfU;
+        i &= w;
+        i ^= i >> 5U;
+    } while (i >= l);
+    return (i + p) % l;
+}
+
+uint32_t reverseBits(uint32_t x)
+{
+    x = ((x >> 1U) & 0x55555555U) | ((x & 0x55555555U) << 1U);
+    x = ((x >> 2U) & 0x33333333U) | ((x & 0x33333333U) << 2U);
+    x = ((x >> 4U) & 0x0f0f0f0fU) | ((x & 0x0f0f0f0fU) << 4U);
+    x = ((x >> 8U) & 0x00ff00ffU) | ((x & 0x00ff00ffU) << 8U);
+    return (x >> 16U) | (x << 16U);
+}
+
+/**
+ * Hash-based Owen scrambling. The Laine-Karras permutation only mixes lower bits into higher bits,
+ * applied to the reversed bits it scrambles every bit depending on the bits above it.
+ */
+uint32_t nestedUniformScramble(uint32_t x, const uint32_t seed)
+{
+    x = reverseBits(x);
+    x += seed;
+    x ^= x * 0x6c50b47cU;
+    x ^= x * 0xb82f1e52U;
+    x ^= x * 0xc7afe638U;
+    x ^= x * 0x8d22f6e6U;
+    return reverseBits(x);
+}
+
+/**
+ * Primitive polynomial of degree s with the coefficients a and the initial direction numbers m
+ * (Joe and Kuo, 2008).
+ */
+struct SobolPolynomial {
+    uint32_t s;
+    uint32_t a;
+    std::array<uint32_t, 3> m;
+};
+
+constexpr std::array<SobolPolynomial, 3> sobol_polynomials = {
+    SobolPolynomial{1, 0, {1}}, SobolPolynomial{2, 1, {1, 3}}, SobolPolynomial{3, 1, {1, 3, 1}}};
+
+using SobolMatrices = std::array<std::array<uint32_t, 32>, 4>;
+
+constexpr SobolMatrices makeSobolMatrices()
+{
+    SobolMatrices v{};
+    for (uint32_t i = 0; i < 32; i++) {
+        v[0][i] = 1U << (31 - i); // van der Corput sequence
+    }
+    for (uint32_t d = 1; d < 4; d++) {
+        const auto& p = sobol_polynomials[d - 1];
+        for (uint32_t i = 0; i < p.s; i++) {
+            v[d][i] = p.m[i] << (31 - i);
+        }
+        for (uint32_t i = p.s; i < 32; i++) {
+            v[d][i] = v[d][i - p.s] ^ (v[d][i - p.s] >> p.s);
+            for (uint32_t k = 1; k < p.s; k++) {
+                v[d][i] ^= ((p.a >> (p.s - 1 - k)) & 1U) * v[d][i - k];
+            }
+        }
+    }
+    return v;
+}
+
+constexpr SobolMatrices sobol_matrices = makeSobolMatrices();
+
+constexpr std::array<uint32_t, 32> primes = {2,  3,  5,  7,  11, 13, 17, 19, 23,  29,  31,
+                                             37, 41, 43, 47, 53, 59, 61, 67, 71,  73,  79,
+                                             83, 89, 97, 101, 103, 107, 109, 113, 127, 131};
+
+/**
+ * Mirrors the digits of the index in the given base at the decimal point.
+ */
+double radicalInverse(const uint32_t base, uint64_t index)
+{
+    const auto inv_base = 1.0 / base;
+    double inv_base_n = 1.0;
+    uint64_t reversed = 0;
+    while (index > 0) {
+        const auto next = index / base;
+        reversed = reversed * base + (index - next * base);
+        inv_base_n *= inv_base;
+        index = next;
+    }
+    return std::min(reversed * inv_base_n, 1.0 - 0x1p-53);
+}
+
+} // namespace
+
+///************************************************************************************************
+/// Sampler
+///************************************************************************************************
+
+Sampler::Sampler(const uint64_t seed) : seed_(seed) {}
+
+void Sampler::startSample(const uint64_t pixel, const uint64_t index)
+{
+    pixel_ = pixel;
+    index_ = index;
+    dimension_ = 0;
+}
+
+std::unique_ptr<Sampler> makeSampler(const SamplerType type,
+                                     const uint64_t seed,
+                                     const size_t samples)
+{
+    switch (type) {
+    case SamplerType::Stratified:
+        return std::make_unique<StratifiedSampler>(seed, samples);
+    case SamplerType::Halton:
+        return std::make_unique<HaltonSampler>(seed);
+    case SamplerType::Sobol:
+        return std::make_unique<SobolSampler>(seed);
+    default:
+        return std::make_unique<IndependentSampler>(seed);
+    }
+}
+
+///************************************************************************************************
+/// Independent sampler
+///************************************************************************************************
+
+IndependentSampler::IndependentSampler(const uint64_t seed) : Sampler(seed) {}
+
+void IndependentSampler::startSample(const uint64_t pixel, const uint64_t index)
+{
+    Sampler::startSample(pixel, index);
+    // the pixel selects the stream and the sample index the position in it
+    engine_.seed(mixBits(seed_ ^ mixBits(index)), mixBits(seed_) ^ pixel);
+}
+
+double IndependentSampler::get1D()
+{
+    dimension_++;
+    return engine_.nextDouble();
+}
+
+glm::dvec2 IndependentSampler::get2D()
+{
+    dimension_ += 2;
+    const auto x = engine_.nextDouble();
+    return {x, engine_.nextDouble()};
+}
+
+///************************************************************************************************
+/// Stratified sampler
+///************************************************************************************************
+
+StratifiedSampler::StratifiedSampler(const uint64_t seed, const size_t samples)
+    : Sampler(seed), strata_1d_(static_cast<uint32_t>(std::max<size_t>(samples, 1))),
+      strata_2d_(static_cast<uint32_t>(std::ceil(std::sqrt(static_cast<double>(strata_1d_)))))
+{
+}
+
+uint32_t StratifiedSampler::stratum(const uint32_t dimension, const uint32_t strata) const
+{
+    // Every block of consecutive samples covers each stratum once. Samples beyond the sample
+    // count, e.g. of the adaptive sampling, continue with a new permutation per block instead of
+    // repeating the strata of the first one.
+    const auto i = static_cast<uint32_t>(index_ % strata);
+    const auto block = index_ / strata;
+    auto key = hash(hash(seed_, pixel_), dimension);
+    if (block > 0) {
+        key = hash(key, block);
+    }
+    return permute(i, strata, key);
+}
+
+double StratifiedSampler::jitter(const uint32_t dimension) const
+{
+    return toUnit(hash(hash(hash(seed_, pixel_), index_), dimension));
+}
+
+double StratifiedSampler::get1D()
+{
+    const auto d = dimension_++;
+    return (stratum(d, strata_1d_) + jitter(d)) / strata_1d_;
+}
+
+glm::dvec2 StratifiedSampler::get2D()
+{
+    const auto d = dimension_;
+    dimension_ += 2;
+    const auto s = stratum(d, strata_2d_ * strata_2d_);
+    return {(s % strata_2d_ + jitter(d)) / strata_2d_,
+            (s / strata_2d_ + jitter(d + 1)) / strata_2d_};
+}
+
+///************************************************************************************************
+/// Halton sampler
+///************************************************************************************************
+
+HaltonSampler::HaltonSampler(const uint64_t seed) : Sampler(seed) {}
+
+double HaltonSampler::sample(const uint32_t dimension) const
+{
+    const auto key = hash(hash(seed_, pixel_), dimension);
+    if (dimension >= primes.size()) {
+        return toUnit(hash(key, index_));
+    }
+    // Cranley-Patterson rotation, the sequence is shifted on the unit torus
+    const auto value = radicalInverse(primes[dimension], index_) + toUnit(key);
+    return value >= 1.0 ? value - 1.0 : value;
+}
+
+double HaltonSampler::get1D() { return sample(dimension_++); }
+
+glm::dvec2 HaltonSampler::get2D()
+{
+    const auto d = dimension_;
+    dimension_ += 2;
+    return {sample(d), sample(d + 1)};
+}
+
+///************************************************************************************************
+/// Sobol sampler
+///************************************************************************************************
+
+SobolSampler::SobolSampler(const uint64_t seed) : Sampler(seed) {}
+
+uint32_t SobolSampler::sobol(uint32_t index, const uint32_t dimension)
+{
+    uint32_t x = 0;
+    for (uint32_t bit = 0; index != 0; index >>= 1U, bit++) {
+        if ((index & 1U) != 0) {
+            x ^= sobol_matrices[dimension][bit];
+        }
+    }
+    return x;
+}
+
+void SobolSampler::startSample(const uint64_t pixel, const uint64_t index)
+{
+    Sampler::startSample(pixel, index);
+    pixel_seed_ = hash(seed_, pixel);
+    startSet(0);
+}
+
+void SobolSampler::startSet(const uint32_t set)
+{
+    set_ = set;
+    set_seed_ = hash(pixel_seed_, set);
+    auto index = nestedUniformScramble(static_cast<uint32_t>(index_), set_seed_);
+    // all four dimensions at once, the shuffled index usually has all 32 bits in use
+    set_point_ = {};
+    for (uint32_t bit = 0; index != 0; index >>= 1U, bit++) {
+        const auto mask = 0U - (index & 1U);
+        for (uint32_t d = 0; d < 4; d++) {
+            set_point_[d] ^= sobol_matrices[d][bit] & mask;
+        }
+    }
+}
+
+double SobolSampler::sample(const uint32_t dimension)
+{
+    if (dimension / 4 != set_) {
+        startSet(dimension / 4);
+    }
+    const auto x = set_point_[dimension % 4];
+    // the scrambling seed only has to differ between the dimensions of the set
+    return toUnit(nestedUniformScramble(x, set_seed_ ^ (0x9e3779b9U * (dimension % 4 + 1))));
+}
+
+double SobolSampler::get1D() { return sample(dimension_++); }
+
+glm::dvec2 SobolSampler::get2D()
+{
+    // keep the pair within one set of four dimensions, the pairs (0, 1) and (2, 3) are stratified
+    dimension_ += dimension_ % 2;
+    const auto d = dimension_;
+    dimension_ += 2;
+    return {sample(d), sample(d + 1)};
+}
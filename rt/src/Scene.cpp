@@ -63,9 +63,9 @@ Scene& Scene::addCornellBox(const double side_len,
     glm::dvec3 p110 = {half_side, half_side, -half_side};
     glm::dvec3 p111 = {half_side, half_side, half_side};
 
-    const auto mat_red = std::make_shared<LambertianMaterial>(red);
-    const auto mat_green = std::make_shared<LambertianMaterial>(green);
-    const auto mat_white = std::make_shared<LambertianMaterial>(white);
+    const auto mat_red = makeMaterial<LambertianMaterial>(red);
+    const auto mat_green = makeMaterial<LambertianMaterial>(green);
+    const auto mat_white = makeMaterial<LambertianMaterial>(white);
 
     // left face
     face = entities::makeQuad(p100, p000, p001, p101);
@@ -96,7 +96,7 @@ Scene& Scene::addCornellBox(const double side_len,
     glm::dvec3 c(half_light, half_light, light_height);
     glm::dvec3 d(half_light, -half_light, light_height);
     face = entities::makeQuad(a, b, c, d);
-    face->setMaterial(std::make_shared<DiffuseLight>(light_intensity * white));
+    face->setMaterial(makeMaterial<DiffuseLight>(light_intensity * white));
     insert(std::move(face));
 
     return *this;
@@ -107,25 +107,25 @@ Scene& Scene::addCornellContent()
     std::unique_ptr<Entity> face;
 
     face = std::make_unique<Sphere>(glm::dvec3{-1.5, 1.5, -2}, 1.0);
-    face->setMaterial(std::make_shared<MetalLikeMaterial>(white, 0.0)); // 0.5
+    face->setMaterial(makeMaterial<MetalLikeMaterial>(white, 0.0)); // 0.5
     insert(std::move(face));
 
     face = obj::Transform()
                .rotate_z(-glm::pi<double>() / 10)
                .translate({-1.5, -1.5, -1})
                .to_bvh(obj::makeCuboid({0, 0, 0}, {2, 2, 4}));
-    face->setMaterial(std::make_shared<LambertianMaterial>(white));
+    face->setMaterial(makeMaterial<LambertianMaterial>(white));
     insert(std::move(face));
 
     //    face = obj::Transform()
     //               .rotate_z(glm::pi<double>() / 10)
     //               .translate({2, 2, -2.5})
     //               .to_bvh(obj::makeCuboid({0, 0, 0}, {1, 1, 1}));
-    //    face->setMaterial(std::make_shared<DiffuseLight>(7.0 * glm::dvec3(1,1,1)));
+    //    face->setMaterial(makeMaterial<DiffuseLight>(7.0 * glm::dvec3(1,1,1)));
     //    insert(std::move(face));
 
     face = std::make_unique<Sphere>(glm::dvec3{1.5, 0.0, -2}, 1.0);
-    face->setMaterial(std::make_shared<Dielectric>(1.4));
+    face->setMaterial(makeMaterial<Dielectric>(1.4));
     insert(std::move(face));
 
     return *this;
@@ -137,25 +137,25 @@ Scene& Scene::addExamRender()
     std::unique_ptr<Entity> face;
 
     face = std::make_unique<Sphere>(glm::dvec3{-1.5, 1.5, -2}, 1.0);
-    face->setMaterial(std::make_shared<MetalLikeMaterial>(white, 0.0)); // 0.5
+    face->setMaterial(makeMaterial<MetalLikeMaterial>(white, 0.0)); // 0.5
     insert(std::move(face));
 
     face = obj::Transform()
                .rotate_z(-glm::pi<double>() / 10)
                .translate({-1.5, -1.5, -1})
                .to_bvh(obj::makeCuboid({0, 0, 0}, {2, 2, 4}));
-    face->setMaterial(std::make_shared<LambertianMaterial>(white));
+    face->setMaterial(makeMaterial<LambertianMaterial>(white));
     insert(std::move(face));
 
     //    face = obj::Transform()
     //               .rotate_z(glm::pi<double>() / 10)
     //               .translate({2, 2, -2.5})
     //               .to_bvh(obj::makeCuboid({0, 0, 0}, {1, 1, 1}));
-    //    face->setMaterial(std::make_shared<DiffuseLight>(7.0 * glm::dvec3(1,1,1)));
+    //    face->setMaterial(makeMaterial<DiffuseLight>(7.0 * glm::dvec3(1,1,1)));
     //    insert(std::move(face));
 
     face = std::make_unique<Sphere>(glm::dvec3{1.5, -2.0, -2.5}, 0.5);
-    face->setMaterial(std::make_shared<Dielectric>(1.4));
+    face->setMaterial(makeMaterial<Dielectric>(1.4));
     insert(std::move(face));
 
     const auto cow_tex = std::make_shared<ImageBackedTexture>(resolveFile(cow_tex_).string());
@@ -167,7 +167,7 @@ Scene& Scene::addExamRender()
                .translate({0.3, 0.3, -2.2})
                .to_bvh(resolveFile(cow_obj_).string());
 
-    face->setMaterial(std::make_shared<LambertianMaterial>(cow_tex));
+    face->setMaterial(makeMaterial<LambertianMaterial>(cow_tex));
     insert(std::move(face));
 
     return addPig({-glm::pi<double>() / 2, 0.0, glm::pi<double>() / 4}, 1, {2, 2, -2.5}, false);
@@ -180,15 +180,15 @@ Scene& Scene::addAxisIndicator()
     const auto tip = glm::dvec3{0, 0, 0};
     const auto id_len = 2;
     auto x_axis = entities::makeCone(tip + glm::dvec3{id_len, 0, 0}, tip, 0.1, 10);
-    x_axis->setMaterial(std::make_shared<LambertianMaterial>(red));
+    x_axis->setMaterial(makeMaterial<LambertianMaterial>(red));
     insert(std::move(x_axis));
 
     auto y_axis = entities::makeCone(tip + glm::dvec3{0, id_len, 0}, tip, 0.1, 10);
-    y_axis->setMaterial(std::make_shared<LambertianMaterial>(green));
+    y_axis->setMaterial(makeMaterial<LambertianMaterial>(green));
     insert(std::move(y_axis));
 
     auto z_axis = entities::makeCone(tip + glm::dvec3{0, 0, id_len}, tip, 0.1, 10);
-    z_axis->setMaterial(std::make_shared<LambertianMaterial>(blue));
+    z_axis->setMaterial(makeMaterial<LambertianMaterial>(blue));
     insert(std::move(z_axis));
 
     return *this;
@@ -209,19 +209,19 @@ Scene& Scene::addPig(glm::dvec3 rotate, double scale, glm::dvec3 translation, bo
     };
 
     face = load_pig_part(resolveFile(pig_body_obj_).string());
-    face->setMaterial(std::make_shared<LambertianMaterial>(glm::dvec3(0.9, 0.6, 0.9)));
+    face->setMaterial(makeMaterial<LambertianMaterial>(glm::dvec3(0.9, 0.6, 0.9)));
     insert(std::move(face));
 
     face = load_pig_part(resolveFile(pig_eyes_obj_).string());
-    face->setMaterial(std::make_shared<LambertianMaterial>(white));
+    face->setMaterial(makeMaterial<LambertianMaterial>(white));
     insert(std::move(face));
 
     face = load_pig_part(resolveFile(pig_pupils_obj_).string());
-    face->setMaterial(std::make_shared<LambertianMaterial>(black));
+    face->setMaterial(makeMaterial<LambertianMaterial>(black));
     insert(std::move(face));
 
     face = load_pig_part(resolveFile(pig_tongue_obj_).string());
-    face->setMaterial(std::make_shared<DiffuseLight>(0.5 * red));
+    face->setMaterial(makeMaterial<DiffuseLight>(0.5 * red));
     insert(std::move(face));
 
     if (add_box) {
@@ -229,7 +229,7 @@ Scene& Scene::addPig(glm::dvec3 rotate, double scale, glm::dvec3 translation, bo
                    .rotate_z(-glm::pi<double>() / 10)
                    .translate({0, 0, -2.75})
                    .to_bvh(obj::makeCuboid({0, 0, 0}, {4, 4, 0.5}));
-        face->setMaterial(std::make_shared<LambertianMaterial>(white));
+        face->setMaterial(makeMaterial<LambertianMaterial>(white));
         insert(std::move(face));
     }
 
@@ -245,8 +245,8 @@ Scene& Scene::addDragon()
                     .scale(25)
                     .translate({0, 0, -1.6})
                     .to_bvh(resolveFile(dragon_obj_).string());
-    //        face->setMaterial(std::make_shared<LambertianMaterial>(white));
-    face->setMaterial(std::make_shared<Dielectric>(1.4));
+    //        face->setMaterial(makeMaterial<LambertianMaterial>(white));
+    face->setMaterial(makeMaterial<Dielectric>(1.4));
     insert(std::move(face));
 
     return *this;
@@ -263,7 +263,7 @@ Scene& Scene::addCow()
                     .translate({0, 0, -1.4})
                     .to_bvh(resolveFile(cow_obj_).string());
 
-    face->setMaterial(std::make_shared<LambertianMaterial>(cow_tex));
+    face->setMaterial(makeMaterial<LambertianMaterial>(cow_tex));
     insert(std::move(face));
 
     return *this;
@@ -273,10 +273,31 @@ void Scene::clear()
 {
     entities_.clear();
     tree_->clear();
+    materials_.clear();
 }
 
 std::shared_ptr<Octree> Scene::getTree() { return tree_; }
 
+std::shared_ptr<const LightList> Scene::getLights() const
+{
+    std::vector<const Entity*> lights;
+    for (const auto& entity : entities_) {
+        entity->collectLights(lights);
+    }
+    return std::make_shared<LightList>(std::move(lights));
+}
+
+double Scene::bvhBuildSeconds() const
+{
+    double seconds = 0;
+    for (const auto& entity : entities_) {
+        if (const auto* bvh = dynamic_cast<const BVH*>(entity.get())) {
+            seconds += bvh->buildStats().build_seconds;
+        }
+    }
+    return seconds;
+}
+
 std::filesystem::path Scene::resolveFile(const std::string& relative_name) const
 {
     std::filesystem::path fullname = share_dir_ / relative_name;
@@ -0,0 +1,198 @@
+/**
+ *    Copyright 2020 Jannik Bamberger
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#include "TrianglePacket.h"
+
+#include "Entity.h"
+#include "RenderStats.h"
+#include <cassert>
+
+// The vectorized kernel is compiled for AVX independently of the target architecture of the
+// build. Whether it is used is decided at runtime, so the same binary also runs on older CPUs.
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define RT_PACKET_AVX 1
+#include <immintrin.h>
+#endif
+
+namespace {
+#ifdef RT_PACKET_AVX
+const bool use_simd = TrianglePacket::simdSupported();
+#else
+const bool use_simd = false;
+#endif
+} // namespace
+
+void TrianglePacket::add(const glm::dvec3& a,
+                         const glm::dvec3& ab,
+                         const glm::dvec3& ac,
+                         const uint32_t index)
+{
+    assert(count < width);
+    for (glm::dvec3::length_type i = 0; i < 3; i++) {
+        this->a[i][count] = a[i];
+        this->ab[i][count] = ab[i];
+        this->ac[i][count] = ac[i];
+    }
+    this->index[count] = index;
+    count++;
+}
+
+bool TrianglePacket::intersect(const Ray& ray,
+                               const double t_max,
+                               uint32_t& lane,
+                               double& t,
+                               glm::dvec2& barycentric) const
+{
+    if (use_simd) {
+        return intersectSimd(ray, t_max, lane, t, barycentric);
+    }
+    return intersectScalar(ray, t_max, lane, t, barycentric);
+}
+
+bool TrianglePacket::intersectScalar(const Ray& ray,
+                                     const double t_max,
+                                     uint32_t& lane,
+                                     double& t,
+                                     glm::dvec2& barycentric) const
+{
+    auto found = false;
+    auto nearest = t_max;
+    for (uint32_t i = 0; i < count; i++) {
+        const glm::dvec3 corner(a[0][i], a[1][i], a[2][i]);
+        const glm::dvec3 edge1(ab[0][i], ab[1][i], ab[2][i]);
+        const glm::dvec3 edge2(ac[0][i], ac[1][i], ac[2][i]);
+        double lane_t;
+        glm::dvec2 lane_barycentric;
+        if (Triangle::intersect(corner, edge1, edge2, ray, nearest, lane_t, lane_barycentric)) {
+            lane = i;
+            t = lane_t;
+            barycentric = lane_barycentric;
+            nearest = lane_t;
+            found = true;
+        }
+    }
+    return found;
+}
+
+#ifdef RT_PACKET_AVX
+bool TrianglePacket::simdSupported()
+{
+    __builtin_cpu_init();
+    return __builtin_cpu_supports("avx");
+}
+
+// The kernel performs the same operations in the same order as Triangle::intersect. Both files are
+// built with -ffp-contract=off, so neither contracts them to fused multiply-adds, and every lane
+// yields the bit-identical result. The comparisons are the negations of the rejection tests of
+// the scalar code, i.e. they are unordered and accept NaN in the same way.
+__attribute__((target("avx"))) bool TrianglePacket::intersectSimd(const Ray& ray,
+                                                                  const double t_max,
+                                                                  uint32_t& lane,
+                                                                  double& t,
+                                                                  glm::dvec2& barycentric) const
+{
+    RenderStats::local().primitive_tests += count;
+
+    const auto one = _mm256_set1_pd(1.0);
+    const auto zero = _mm256_setzero_pd();
+    const auto dx = _mm256_set1_pd(ray.dir.x);
+    const auto dy = _mm256_set1_pd(ray.dir.y);
+    const auto dz = _mm256_set1_pd(ray.dir.z);
+    const auto abx = _mm256_loadu_pd(ab[0].data());
+    const auto aby = _mm256_loadu_pd(ab[1].data());
+    const auto abz = _mm256_loadu_pd(ab[2].data());
+    const auto acx = _mm256_loadu_pd(ac[0].data());
+    const auto acy = _mm256_loadu_pd(ac[1].data());
+    const auto acz = _mm256_loadu_pd(ac[2].data());
+
+    // P = cross(dir, ac), det = dot(ab, P)
+    const auto px = _mm256_sub_pd(_mm256_mul_pd(dy, acz), _mm256_mul_pd(dz, acy));
+    const auto py = _mm256_sub_pd(_mm256_mul_pd(dz, acx), _mm256_mul_pd(dx, acz));
+    const auto pz = _mm256_sub_pd(_mm256_mul_pd(dx, acy), _mm256_mul_pd(dy, acx));
+    const auto det = _mm256_add_pd(
+        _mm256_add_pd(_mm256_mul_pd(abx, px), _mm256_mul_pd(aby, py)), _mm256_mul_pd(abz, pz));
+    const auto abs_det = _mm256_andnot_pd(_mm256_set1_pd(-0.0), det);
+    auto valid = _mm256_cmp_pd(abs_det, _mm256_set1_pd(1e-14), _CMP_NLT_UQ);
+    const auto inv_det = _mm256_div_pd(one, det);
+
+    // AO = origin - a, u = dot(AO, P) / det
+    const auto aox = _mm256_sub_pd(_mm256_set1_pd(ray.origin.x), _mm256_loadu_pd(a[0].data()));
+    const auto aoy = _mm256_sub_pd(_mm256_set1_pd(ray.origin.y), _mm256_loadu_pd(a[1].data()));
+    const auto aoz = _mm256_sub_pd(_mm256_set1_pd(ray.origin.z), _mm256_loadu_pd(a[2].data()));
+    const auto u = _mm256_mul_pd(
+        _mm256_add_pd(_mm256_add_pd(_mm256_mul_pd(aox, px), _mm256_mul_pd(aoy, py)),
+                      _mm256_mul_pd(aoz, pz)),
+        inv_det);
+    valid = _mm256_and_pd(valid, _mm256_cmp_pd(u, zero, _CMP_NLT_UQ));
+    valid = _mm256_and_pd(valid, _mm256_cmp_pd(u, one, _CMP_NGT_UQ));
+
+    // Q = cross(AO, ab), v = dot(dir, Q) / det
+    const auto qx = _mm256_sub_pd(_mm256_mul_pd(aoy, abz), _mm256_mul_pd(aoz, aby));
+    const auto qy = _mm256_sub_pd(_mm256_mul_pd(aoz, abx), _mm256_mul_pd(aox, abz));
+    const auto qz = _mm256_sub_pd(_mm256_mul_pd(aox, aby), _mm256_mul_pd(aoy, abx));
+    const auto v = _mm256_mul_pd(
+        _mm256_add_pd(_mm256_add_pd(_mm256_mul_pd(dx, qx), _mm256_mul_pd(dy, qy)),
+                      _mm256_mul_pd(dz, qz)),
+        inv_det);
+    valid = _mm256_and_pd(valid, _mm256_cmp_pd(v, zero, _CMP_NLT_UQ));
+    valid = _mm256_and_pd(valid, _mm256_cmp_pd(_mm256_add_pd(u, v), one, _CMP_NGT_UQ));
+
+    // t = dot(ac, Q) / det must lie within the ray interval
+    const auto dist = _mm256_mul_pd(
+        _mm256_add_pd(_mm256_add_pd(_mm256_mul_pd(acx, qx), _mm256_mul_pd(acy, qy)),
+                      _mm256_mul_pd(acz, qz)),
+        inv_det);
+    valid = _mm256_and_pd(valid, _mm256_cmp_pd(dist, _mm256_set1_pd(ray.t_min), _CMP_NLE_UQ));
+    valid = _mm256_and_pd(valid, _mm256_cmp_pd(dist, _mm256_set1_pd(t_max), _CMP_NGE_UQ));
+
+    auto mask = static_cast<uint32_t>(_mm256_movemask_pd(valid)) & ((1u << count) - 1);
+    if (mask == 0) {
+        return false;
+    }
+
+    // Reduce to the closest hit. Ties are resolved in favor of the first lane like in the
+    // sequential test.
+    alignas(32) Lanes ts;
+    alignas(32) Lanes us;
+    alignas(32) Lanes vs;
+    _mm256_store_pd(ts.data(), dist);
+    _mm256_store_pd(us.data(), u);
+    _mm256_store_pd(vs.data(), v);
+    auto best = static_cast<uint32_t>(__builtin_ctz(mask));
+    for (mask &= mask - 1; mask != 0; mask &= mask - 1) {
+        const auto i = static_cast<uint32_t>(__builtin_ctz(mask));
+        if (ts[i] < ts[best]) {
+            best = i;
+        }
+    }
+    lane = best;
+    t = ts[best];
+    barycentric = {us[best], vs[best]};
+    return true;
+}
+#else
+bool TrianglePacket::simdSupported() { return false; }
+
+bool TrianglePacket::intersectSimd(const Ray& ray,
+                                   const double t_max,
+                                   uint32_t& lane,
+                                   double& t,
+                                   glm::dvec2& barycentric) const
+{
+    return intersectScalar(ray, t_max, lane, t, barycentric);
+}
+#endif
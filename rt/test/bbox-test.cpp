@@ -53,6 +53,16 @@ TEST_P(RayBBoxIntersectionTest, testRayIntersection)
     ASSERT_EQ(success, p.success);
 }
 
+TEST_P(RayBBoxIntersectionTest, testFloatRayIntersection)
+{
+    const auto p = GetParam();
+    float entry;
+    const auto success = BoundingBox::intersect(glm::vec3(bb.min), glm::vec3(bb.max),
+                                                TraversalRay<float>(p.ray), entry);
+
+    ASSERT_EQ(success, p.success);
+}
+
 // clang-format off
 INSTANTIATE_TEST_SUITE_P(Default, RayBBoxIntersectionTest, testing::Values(
 	ray_definition{true,  { 2,  0,  0}, {-1,  0,  0}, "front into the box"       },
@@ -78,7 +88,10 @@ INSTANTIATE_TEST_SUITE_P(Default, RayBBoxIntersectionTest, testing::Values(
 	ray_definition{true,  { 2,  2,  2}, {-1, -1, -1}, "diagonal through the box" },
 	ray_definition{true,  { 0,  0,  0}, { 1,  1,  1}, "from within the box"      },
 
-	ray_definition{true,  { 2,  0,  0}, {-1, -0, -0}, "front of box neg. zero"   }
+	ray_definition{true,  { 2,  0,  0}, {-1, -0, -0}, "front of box neg. zero"   },
+	ray_definition{true,  { 1, -2,  0}, { 0,  1,  0}, "within the front plane"   },
+	ray_definition{true,  { 0, -1, -2}, {-0,  0,  1}, "along an edge"            },
+	ray_definition{false, { 1,  2,  0}, { 0,  1,  0}, "away in the front plane"  }
 ));
 // clang-format on
 
@@ -216,3 +229,74 @@ TEST(FlatBBoxTest, testFlatboxTop)
 
     ASSERT_TRUE(box.intersect(r));
 }
+
+TEST(RayIntervalBBoxTest, testEntryDistance)
+{
+    const BoundingBox box({-1, -1, -1}, {1, 1, 1});
+    const Ray r({-3, 0, 0}, {1, 0, 0});
+
+    double entry = 0;
+    ASSERT_TRUE(box.intersect(r, entry));
+    EXPECT_DOUBLE_EQ(entry, 2.0);
+}
+
+TEST(RayIntervalBBoxTest, testEntryDistanceInside)
+{
+    const BoundingBox box({-1, -1, -1}, {1, 1, 1});
+    const Ray r({0, 0, 0}, {1, 0, 0});
+
+    double entry = -1;
+    ASSERT_TRUE(box.intersect(r, entry));
+    EXPECT_DOUBLE_EQ(entry, 0.0);
+}
+
+TEST(RayIntervalBBoxTest, testClippedBeforeBox)
+{
+    const BoundingBox box({-1, -1, -1}, {1, 1, 1});
+    Ray r({-3, 0, 0}, {1, 0, 0});
+    r.t_max = 1.5;
+
+    ASSERT_FALSE(box.intersect(r));
+}
+
+TEST(RayIntervalBBoxTest, testClippedBehindBox)
+{
+    const BoundingBox box({-1, -1, -1}, {1, 1, 1});
+    Ray r({-3, 0, 0}, {1, 0, 0});
+    r.t_min = 4.5;
+
+    ASSERT_FALSE(box.intersect(r));
+}
+
+TEST(TraversalRayTest, testIntervalRoundedOutwards)
+{
+    Ray r({0, 0, 0}, {1, 0, 0});
+    r.t_min = 0.1;
+    r.t_max = 0.3;
+    const TraversalRay<float> t(r);
+    EXPECT_LE(t.t_min, 0.1);
+    EXPECT_GE(t.t_max, 0.3);
+    EXPECT_TRUE(std::isinf(TraversalRay<float>(Ray()).t_max));
+}
+
+TEST(TraversalRayTest, testBoxAtEndOfInterval)
+{
+    // the box starts exactly at the end of the interval, which the float conversion must keep
+    Ray r({0, 0, 0}, {1, 0, 0});
+    r.t_max = 0.1;
+    const TraversalRay<float> t(r);
+    float entry;
+    EXPECT_TRUE(BoundingBox::intersect(glm::vec3(0.1f, -1, -1), glm::vec3(1, 1, 1), t, entry));
+    EXPECT_FLOAT_EQ(entry, 0.1f);
+}
+
+TEST(TraversalRayTest, testReciprocalAndSigns)
+{
+    const Ray r({0, 0, 0}, {-0.0, 1, -1});
+    EXPECT_TRUE(std::isinf(r.inv_dir.x));
+    EXPECT_LT(r.inv_dir.x, 0);
+    EXPECT_DOUBLE_EQ(r.inv_dir.y, std::sqrt(2.0));
+    EXPECT_EQ(r.sign[0], 1);
+    EXPECT_EQ(r.sign[1], 0);
+    EXPECT_EQ(r.sign[2], 1);
+}
@@ -0,0 +1,272 @@
+/**
+ *    Copyright 2020 Jannik Bamberger
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "BVH.h"
+#include "ExplicitEntity.h"
+#include "ObjReader.h"
+#include "Pcg32.h"
+#include "RayPacket.h"
+
+#include <algorithm>
+#include <cmath>
+#include <glm/gtc/constants.hpp>
+#include <gtest/gtest.h>
+#include <limits>
+#include <tuple>
+#include <vector>
+
+constexpr static auto eps = 1e-9;
+
+/**
+ * \brief Compares the hierarchy against the brute force intersection of all triangles. The rays
+ * originate on a sphere around the mesh and point to positions scattered around the center.
+ */
+struct BVHIntersectionTest : testing::TestWithParam<std::tuple<size_t, BVH::SplitMethod>> {
+    obj::ObjContent mesh;
+
+    BVHIntersectionTest()
+    {
+        mesh = obj::makeSphere({0, 0, 0}, 1.0, 3);
+        const auto cube = obj::makeCuboid({0.5, -0.3, 0.2}, {1.2, 0.4, 2.0});
+        mesh.insert(mesh.end(), cube.begin(), cube.end());
+    }
+
+    [[nodiscard]] static std::vector<Ray> makeRays()
+    {
+        std::vector<Ray> rays;
+        constexpr auto steps = 24;
+        for (auto i = 0; i < steps; i++) {
+            for (auto j = 0; j < steps; j++) {
+                const auto phi = glm::two_pi<double>() * i / steps;
+                const auto theta = glm::pi<double>() * (j + 0.5) / steps;
+                const glm::dvec3 origin = 4.0 * glm::dvec3{glm::cos(phi) * glm::sin(theta),
+                                                           glm::sin(phi) * glm::sin(theta),
+                                                           glm::cos(theta)};
+                const glm::dvec3 target{0.7 * glm::sin(3.0 * i), 0.7 * glm::cos(5.0 * j),
+                                        0.7 * glm::sin(7.0 * (i + j))};
+                rays.emplace_back(origin, target - origin);
+            }
+        }
+        return rays;
+    }
+
+    /**
+     * Primary rays of a camera in front of the mesh in blocks of 8x8 pixels, i.e. every packet
+     * of 64 rays has a common origin.
+     */
+    [[nodiscard]] static std::vector<Ray> makeCameraRays()
+    {
+        std::vector<Ray> rays;
+        constexpr auto size = 32;
+        const glm::dvec3 origin{3.0, -2.5, 1.5};
+        for (auto by = 0; by < size; by += 8) {
+            for (auto bx = 0; bx < size; bx += 8) {
+                for (auto y = by; y < by + 8; y++) {
+                    for (auto x = bx; x < bx + 8; x++) {
+                        const glm::dvec3 target{0.0, 2.4 * x / size - 1.2, 1.2 - 2.4 * y / size};
+                        rays.emplace_back(origin, target - origin);
+                    }
+                }
+            }
+        }
+        return rays;
+    }
+};
+
+TEST_P(BVHIntersectionTest, testMatchesBruteForce)
+{
+    const BVH bvh(mesh, std::get<0>(GetParam()), std::get<1>(GetParam()));
+    const ExplicitEntity reference(mesh);
+
+    for (const auto& ray : makeRays()) {
+        Hit expected_hit;
+        Hit hit;
+        const auto expected = reference.intersect(ray, expected_hit);
+        ASSERT_EQ(bvh.intersect(ray, hit), expected);
+        if (expected) {
+            expected_hit.finalize(ray);
+            hit.finalize(ray);
+            EXPECT_NEAR(hit.pos.x, expected_hit.pos.x, eps);
+            EXPECT_NEAR(hit.pos.y, expected_hit.pos.y, eps);
+            EXPECT_NEAR(hit.pos.z, expected_hit.pos.z, eps);
+        }
+    }
+}
+
+TEST_P(BVHIntersectionTest, testPacketMatchesSingleRays)
+{
+    const BVH bvh(mesh, std::get<0>(GetParam()), std::get<1>(GetParam()));
+
+    // scattered rays without a common origin and coherent rays
+    for (const auto& rays : {makeRays(), makeCameraRays()}) {
+        RayPacket packet;
+        for (size_t first = 0; first < rays.size(); first += RayPacket::max_size) {
+            packet.clear();
+            const auto last = std::min(first + RayPacket::max_size, rays.size());
+            for (auto i = first; i < last; i++) {
+                packet.add(rays[i]);
+            }
+            bvh.intersectPacket(packet, packet.all());
+
+            for (auto i = first; i < last; i++) {
+                Hit expected_hit;
+                const auto expected = bvh.intersect(rays[i], expected_hit);
+                const auto k = i - first;
+                ASSERT_EQ((packet.found >> k & 1) != 0, expected);
+                if (expected) {
+                    // the triangle may differ if two triangles are hit at the same distance
+                    EXPECT_EQ(packet.hits[k].t, expected_hit.t);
+                    EXPECT_EQ(packet.rays[k].t_max, expected_hit.t);
+                }
+            }
+        }
+    }
+}
+
+TEST_P(BVHIntersectionTest, testOcclusionMatchesClosestHit)
+{
+    const BVH bvh(mesh, std::get<0>(GetParam()), std::get<1>(GetParam()));
+    const ExplicitEntity reference(mesh);
+
+    for (const auto& ray : makeRays()) {
+        Hit hit;
+        if (!reference.intersect(ray, hit)) {
+            EXPECT_FALSE(bvh.occluded(ray, std::numeric_limits<double>::infinity()));
+            EXPECT_FALSE(reference.occluded(ray, std::numeric_limits<double>::infinity()));
+            continue;
+        }
+        // the interval ends just before or just after the closest hit
+        EXPECT_FALSE(bvh.occluded(ray, hit.t * (1 - 1e-6)));
+        EXPECT_TRUE(bvh.occluded(ray, hit.t * (1 + 1e-6)));
+        EXPECT_FALSE(reference.occluded(ray, hit.t * (1 - 1e-6)));
+        EXPECT_TRUE(reference.occluded(ray, hit.t * (1 + 1e-6)));
+    }
+}
+
+TEST_P(BVHIntersectionTest, testEdgesFarFromOrigin)
+{
+    // Far from the world origin the single precision copy of a ray origin is off by more than
+    // the padding of the node boxes. Rays which graze the edges of the triangles must still find
+    // the same hits as the brute force test, also in packets with a common origin.
+    const auto far_mesh = obj::makeCuboid({17, -19, 19}, {4, 3, 2});
+    const BVH bvh(far_mesh, std::get<0>(GetParam()), std::get<1>(GetParam()));
+    const ExplicitEntity reference(far_mesh);
+    Pcg32 rng(42);
+    const auto random = [&rng](const double scale) {
+        return scale * glm::dvec3{2 * rng.nextDouble() - 1, 2 * rng.nextDouble() - 1,
+                                  2 * rng.nextDouble() - 1};
+    };
+
+    size_t hits = 0;
+    for (const auto& triangle : far_mesh) {
+        for (const auto& [from, to] : {std::pair{triangle.A, triangle.B},
+                                       std::pair{triangle.B, triangle.C},
+                                       std::pair{triangle.C, triangle.A}}) {
+            const auto origin = (from + to) / 2.0 + random(4.0);
+            RayPacket packet;
+            for (size_t i = 0; i < RayPacket::max_size; i++) {
+                const auto target = from + (to - from) * rng.nextDouble() + random(1e-6);
+                packet.add(Ray(origin, target - origin));
+            }
+            const auto rays = packet.rays;
+            bvh.intersectPacket(packet, packet.all());
+
+            for (size_t i = 0; i < packet.size; i++) {
+                const auto& ray = rays[i];
+                Hit expected_hit;
+                Hit hit;
+                const auto expected = reference.intersect(ray, expected_hit);
+                ASSERT_EQ(bvh.intersect(ray, hit), expected);
+                ASSERT_EQ(bvh.occluded(ray, std::numeric_limits<double>::infinity()), expected);
+                ASSERT_EQ((packet.found >> i & 1) != 0, expected);
+                if (expected) {
+                    EXPECT_EQ(hit.t, expected_hit.t);
+                    EXPECT_EQ(packet.hits[i].t, expected_hit.t);
+                    hits++;
+                }
+            }
+        }
+    }
+    EXPECT_GT(hits, 0);
+}
+
+TEST_P(BVHIntersectionTest, testBoundingBox)
+{
+    const BVH bvh(mesh, std::get<0>(GetParam()), std::get<1>(GetParam()));
+    const auto expected = obj::computeBBox(mesh);
+
+    EXPECT_EQ(bvh.boundingBox().min, expected.min);
+    EXPECT_EQ(bvh.boundingBox().max, expected.max);
+}
+
+TEST_P(BVHIntersectionTest, testBuildStats)
+{
+    const BVH bvh(mesh, std::get<0>(GetParam()), std::get<1>(GetParam()));
+    const auto stats = bvh.buildStats();
+
+    // every node except the root is a child of one of the inner nodes with up to four children
+    const auto inner_count = stats.node_count - stats.leaf_count;
+    EXPECT_GE(inner_count, 1);
+    EXPECT_GE(stats.node_count - 1, inner_count);
+    EXPECT_LE(stats.node_count - 1, 4 * inner_count);
+    EXPECT_NEAR(stats.average_leaf_size * static_cast<double>(stats.leaf_count),
+                static_cast<double>(mesh.size()), 1e-6);
+    EXPECT_LE(stats.average_leaf_size,
+              static_cast<double>(std::max<size_t>(std::get<0>(GetParam()), 1)));
+    EXPECT_GE(stats.sah_cost, 1.0);
+    EXPECT_LT(stats.max_depth, 64);
+    // every leaf fills its packets except the last one
+    const auto node_bytes = 128 * inner_count;
+    const auto packets = (stats.traversal_bytes - node_bytes) / sizeof(TrianglePacket);
+    EXPECT_EQ(stats.traversal_bytes, node_bytes + packets * sizeof(TrianglePacket));
+    EXPECT_GE(packets * TrianglePacket::width, mesh.size());
+    EXPECT_LT(packets * TrianglePacket::width,
+              mesh.size() + stats.leaf_count * TrianglePacket::width);
+}
+
+INSTANTIATE_TEST_SUITE_P(CutoffSize,
+                         BVHIntersectionTest,
+                         testing::Combine(testing::Values(1, 2, 4, 20, 100000),
+                                          testing::Values(BVH::SplitMethod::Median,
+                                                          BVH::SplitMethod::SAH)));
+
+TEST(BVHBuildTest, testSAHCostBelowMedian)
+{
+    // spheres of different size are spread unevenly, the median split produces overlapping nodes
+    obj::ObjContent mesh;
+    for (auto i = 0; i < 8; i++) {
+        const auto sphere = obj::makeSphere({i * i * 0.5, glm::sin(i), 0}, 0.1 + 0.1 * i, 3);
+        mesh.insert(mesh.end(), sphere.begin(), sphere.end());
+    }
+
+    const auto median = BVH(mesh, 4, BVH::SplitMethod::Median).buildStats();
+    const auto sah = BVH(mesh, 4, BVH::SplitMethod::SAH).buildStats();
+
+    EXPECT_LT(sah.sah_cost, median.sah_cost);
+}
+
+TEST(BVHBuildTest, testCollapsedNodesAreFull)
+{
+    // with single triangle leaves every inner node of the binary tree has inner children to pull up
+    const auto mesh = obj::makeSphere({0, 0, 0}, 1.0, 4);
+    const auto stats = BVH(mesh, 1, BVH::SplitMethod::SAH).buildStats();
+    const auto inner_count = stats.node_count - stats.leaf_count;
+
+    EXPECT_EQ(stats.leaf_count, mesh.size());
+    EXPECT_GE(static_cast<double>(stats.node_count - 1) / static_cast<double>(inner_count), 3.0);
+    // a balanced binary tree would be log2(n) levels deep
+    EXPECT_LT(static_cast<double>(stats.max_depth), std::log2(mesh.size()));
+}
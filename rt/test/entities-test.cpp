@@ -82,7 +82,9 @@ TEST_P(TriangleIntersectionTest, testIntersect)
 {
     const auto params = GetParam();
     const Ray ray{{10, 0, 0}, params.direction};
-    static_cast<void>(triangle.intersect(ray, hit));
+    if (triangle.intersect(ray, hit)) {
+        hit.finalize(ray);
+    }
 
     if (params.success) {
         EXPECT_NEAR(hit.pos.x, params.expected_intersect.x, eps);
@@ -95,7 +97,9 @@ TEST_P(TriangleIntersectionTest, testNormal)
 {
     const auto params = GetParam();
     const Ray ray{{10, 0, 0}, params.direction};
-    static_cast<void>(triangle.intersect(ray, hit));
+    if (triangle.intersect(ray, hit)) {
+        hit.finalize(ray);
+    }
 
     if (params.success) {
         EXPECT_NEAR(hit.normal.x, params.expected_normal.x, eps);
@@ -141,7 +145,9 @@ TEST_P(ImplicitSphereIntersectionTest, testIntersect)
 {
     const auto params = GetParam();
     const Ray ray{{10, 0, 0}, params.direction};
-    static_cast<void>(sphere.intersect(ray, hit));
+    if (sphere.intersect(ray, hit)) {
+        hit.finalize(ray);
+    }
 
     if (params.success) {
         EXPECT_NEAR(hit.pos.x, params.expected_intersect.x, eps);
@@ -154,7 +160,9 @@ TEST_P(ImplicitSphereIntersectionTest, testNormal)
 {
     const auto params = GetParam();
     const Ray ray{{10, 0, 0}, params.direction};
-    static_cast<void>(sphere.intersect(ray, hit));
+    if (sphere.intersect(ray, hit)) {
+        hit.finalize(ray);
+    }
 
     if (params.success) {
         EXPECT_NEAR(hit.normal.x, params.expected_normal.x, eps);
@@ -190,6 +198,95 @@ INSTANTIATE_TEST_SUITE_P(CloseToBorder, ImplicitSphereIntersectionTest, testing:
 ));
 // clang-format on
 
+//#####################################################################################################################
+// Ray interval tests
+//#####################################################################################################################
+
+TEST(RayIntervalTest, testTriangleDistance)
+{
+    const Triangle triangle({0, 0, 0}, {0, 1, 0}, {0, 0, 1});
+    const Ray ray{{10, 0.1, 0.1}, {-1, 0, 0}};
+    Hit hit;
+
+    ASSERT_TRUE(triangle.intersect(ray, hit));
+    EXPECT_NEAR(hit.t, 10, eps);
+}
+
+TEST(RayIntervalTest, testTriangleFinalize)
+{
+    Triangle triangle({0, 0, 0}, {0, 1, 0}, {0, 0, 1});
+    triangle.setTexCoords({0.2, 0.2}, {0.8, 0.2}, {0.2, 0.8});
+    const Ray ray{{10, 0.25, 0.5}, {-1, 0, 0}};
+    Hit hit;
+
+    ASSERT_TRUE(triangle.intersect(ray, hit));
+    EXPECT_EQ(hit.entity, &triangle);
+    EXPECT_NEAR(hit.barycentric.x, 0.25, eps);
+    EXPECT_NEAR(hit.barycentric.y, 0.5, eps);
+
+    hit.finalize(ray);
+    const auto uv = triangle.texMapping(hit.pos);
+    EXPECT_NEAR(hit.uv.x, uv.x, eps);
+    EXPECT_NEAR(hit.uv.y, uv.y, eps);
+    EXPECT_NEAR(hit.pos.y, 0.25, eps);
+    EXPECT_NEAR(hit.pos.z, 0.5, eps);
+}
+
+TEST(RayIntervalTest, testTriangleBeyondMax)
+{
+    const Triangle triangle({0, 0, 0}, {0, 1, 0}, {0, 0, 1});
+    Ray ray{{10, 0.1, 0.1}, {-1, 0, 0}};
+    ray.t_max = 9.5;
+    Hit hit;
+
+    EXPECT_FALSE(triangle.intersect(ray, hit));
+}
+
+TEST(RayIntervalTest, testSphereFarSide)
+{
+    const Sphere sphere({0, 0, 0}, 1);
+    Ray ray{{10, 0, 0}, {-1, 0, 0}};
+    ray.t_min = 9.5;
+    Hit hit;
+
+    ASSERT_TRUE(sphere.intersect(ray, hit));
+    hit.finalize(ray);
+    EXPECT_NEAR(hit.t, 11, eps);
+    EXPECT_NEAR(hit.pos.x, -1, eps);
+}
+
+TEST(RayIntervalTest, testSphereBeyondMax)
+{
+    const Sphere sphere({0, 0, 0}, 1);
+    Ray ray{{10, 0, 0}, {-1, 0, 0}};
+    ray.t_max = 8.5;
+    Hit hit;
+
+    EXPECT_FALSE(sphere.intersect(ray, hit));
+}
+
+TEST(OcclusionTest, testTriangleWithinDistance)
+{
+    const Triangle tri({0, 0, 0}, {1, 0, 0}, {0, 1, 0});
+    const Ray ray{{0.2, 0.2, 3}, {0, 0, -1}};
+
+    EXPECT_TRUE(tri.occluded(ray, 3.5));
+    EXPECT_FALSE(tri.occluded(ray, 2.5));
+}
+
+TEST(OcclusionTest, testSphereWithinDistance)
+{
+    const Sphere sphere({0, 0, 0}, 1);
+    Ray ray{{10, 0, 0}, {-1, 0, 0}};
+
+    EXPECT_TRUE(sphere.occluded(ray, 9.5));
+    EXPECT_FALSE(sphere.occluded(ray, 8.5));
+
+    // the ray interval applies as well
+    ray.t_max = 8.5;
+    EXPECT_FALSE(sphere.occluded(ray, 20));
+}
+
 // TEST(ImplicitSphere, center)
 //{
 //    implicit_sphere s1;
@@ -0,0 +1,82 @@
+/**
+ *    Copyright 2020 Jannik Bamberger
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "LightList.h"
+#include "Material.h"
+#include "Scene.h"
+#include <gtest/gtest.h>
+
+TEST(LightListTest, testTriangleSampleOnSurface)
+{
+    const Triangle tri({0, 0, 0}, {2, 0, 0}, {0, 2, 0});
+    EXPECT_DOUBLE_EQ(tri.area(), 2.0);
+
+    for (auto i = 0; i < 10; i++) {
+        for (auto j = 0; j < 10; j++) {
+            Hit hit;
+            tri.sample({i / 10.0, j / 10.0}, hit);
+            EXPECT_EQ(hit.entity, &tri);
+            EXPECT_NEAR(hit.pos.z, 0, 1e-12);
+            EXPECT_GE(hit.pos.x, -1e-12);
+            EXPECT_GE(hit.pos.y, -1e-12);
+            EXPECT_LE(hit.pos.x + hit.pos.y, 2 + 1e-12);
+            EXPECT_EQ(hit.normal, glm::dvec3(0, 0, 1));
+        }
+    }
+}
+
+TEST(LightListTest, testSphereSampleOnSurface)
+{
+    const Sphere sphere({1, 2, 3}, 2);
+    EXPECT_DOUBLE_EQ(sphere.area(), 16 * glm::pi<double>());
+
+    Hit hit;
+    sphere.sample({0.3, 0.8}, hit);
+    EXPECT_NEAR(glm::length(hit.pos - sphere.center), 2, 1e-12);
+    EXPECT_NEAR(glm::dot(hit.normal, glm::normalize(hit.pos - sphere.center)), 1, 1e-12);
+}
+
+TEST(LightListTest, testSelectionProportionalToPower)
+{
+    const DiffuseLight bright(glm::dvec3(4, 4, 4));
+    const DiffuseLight dim(glm::dvec3(1, 1, 1));
+    Triangle a({0, 0, 0}, {1, 0, 0}, {0, 1, 0});
+    Triangle b({0, 0, 1}, {1, 0, 1}, {0, 1, 1});
+    a.setMaterial(&bright);
+    b.setMaterial(&dim);
+    const Triangle other({0, 0, 2}, {1, 0, 2}, {0, 1, 2});
+
+    const LightList lights({&a, &b});
+    ASSERT_EQ(lights.size(), 2);
+    EXPECT_NEAR(lights.pdf(&a) * a.area(), 0.8, 1e-12);
+    EXPECT_NEAR(lights.pdf(&b) * b.area(), 0.2, 1e-12);
+    EXPECT_EQ(lights.pdf(&other), 0);
+
+    const auto first = lights.sample(0.1, {0.5, 0.5});
+    EXPECT_EQ(first.hit.entity, &a);
+    EXPECT_DOUBLE_EQ(first.pdf, lights.pdf(&a));
+    EXPECT_EQ(lights.sample(0.9, {0.5, 0.5}).hit.entity, &b);
+}
+
+TEST(LightListTest, testCornellBoxLights)
+{
+    Scene scene(".", glm::dvec3{-20, -20, -20}, glm::dvec3{20, 20, 20});
+    scene.useSceneSetting(SceneSetting::Cornell);
+
+    // the ceiling light is a quad of two triangles
+    const auto lights = scene.getLights();
+    EXPECT_EQ(lights->size(), 2);
+}
@@ -0,0 +1,100 @@
+/**
+ *    Copyright 2020 Jannik Bamberger
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "Material.h"
+#include <gtest/gtest.h>
+
+/**
+ * Creates a hit on the xy-plane with the normal pointing upwards.
+ */
+static Hit planeHit()
+{
+    Hit hit;
+    hit.pos = {0, 0, 0};
+    hit.normal = {0, 0, 1};
+    hit.uv = {0.5, 0.5};
+    return hit;
+}
+
+TEST(MaterialTest, testLambertianSampleMatchesEvaluate)
+{
+    const LambertianMaterial mat(glm::dvec3(0.5, 0.25, 1.0));
+    const auto hit = planeHit();
+    const Ray in({1, 0, 1}, {-1, 0, -1});
+    IndependentSampler sampler(5);
+
+    for (auto i = 0; i < 100; i++) {
+        sampler.startSample(0, i);
+        ScatterRecord rec;
+        ASSERT_TRUE(mat.scatter(in, hit, sampler, rec));
+        EXPECT_FALSE(rec.specular);
+        EXPECT_GT(glm::dot(rec.ray.dir, hit.normal), 0);
+        EXPECT_NEAR(rec.pdf, mat.pdf(hit, in.dir, rec.ray.dir), 1e-12);
+
+        const auto f = mat.evaluate(hit, in.dir, rec.ray.dir);
+        const auto weight = f * glm::dot(rec.ray.dir, hit.normal) / rec.pdf;
+        EXPECT_NEAR(weight.x, rec.attenuation.x, 1e-9);
+        EXPECT_NEAR(weight.y, rec.attenuation.y, 1e-9);
+        EXPECT_NEAR(weight.z, rec.attenuation.z, 1e-9);
+    }
+}
+
+TEST(MaterialTest, testLambertianPdfIntegratesToOne)
+{
+    const LambertianMaterial mat(glm::dvec3(1, 1, 1));
+    const auto hit = planeHit();
+    const glm::dvec3 wi = glm::normalize(glm::dvec3(0.3, 0, -1));
+
+    // midpoint rule over the sphere in (cos theta, phi)
+    constexpr auto n = 200;
+    double sum = 0;
+    for (auto i = 0; i < n; i++) {
+        const auto z = -1 + (i + 0.5) * 2.0 / n;
+        for (auto j = 0; j < n; j++) {
+            const auto phi = (j + 0.5) * glm::two_pi<double>() / n;
+            const auto r = glm::sqrt(1 - z * z);
+            sum += mat.pdf(hit, wi, {r * glm::cos(phi), r * glm::sin(phi), z});
+        }
+    }
+    EXPECT_NEAR(sum * 4 * glm::pi<double>() / (n * n), 1.0, 1e-3);
+}
+
+TEST(MaterialTest, testLambertianNoTransmission)
+{
+    const LambertianMaterial mat(glm::dvec3(1, 1, 1));
+    const auto hit = planeHit();
+    const glm::dvec3 wi(0, 0, -1);
+    const glm::dvec3 below(0, 0, -1);
+    EXPECT_EQ(mat.pdf(hit, wi, below), 0);
+    EXPECT_EQ(mat.evaluate(hit, wi, below), glm::dvec3(0, 0, 0));
+
+    // from below the surface the reflection happens on the lower side
+    EXPECT_GT(mat.pdf(hit, -wi, below), 0);
+}
+
+TEST(MaterialTest, testDielectricIsSpecular)
+{
+    const Dielectric mat(1.5);
+    const auto hit = planeHit();
+    const Ray in({0, 0, 1}, {0, 0, -1});
+    IndependentSampler sampler(5);
+    sampler.startSample(0, 0);
+
+    ScatterRecord rec;
+    ASSERT_TRUE(mat.scatter(in, hit, sampler, rec));
+    EXPECT_TRUE(rec.specular);
+    EXPECT_EQ(rec.attenuation, glm::dvec3(1, 1, 1));
+}
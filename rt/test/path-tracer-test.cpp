@@ -0,0 +1,263 @@
+/**
+ *    Copyright 2020 Jannik Bamberger
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "PathTracer.h"
+#include "Scene.h"
+#include <atomic>
+#include <gtest/gtest.h>
+#include <thread>
+
+/**
+ * Renders the cornell box with a fixed seed and the given number of threads.
+ */
+static std::shared_ptr<Image>
+renderCornell(const int threads, const uint64_t seed, const bool packets = true)
+{
+    Scene scene(".", glm::dvec3{-20, -20, -20}, glm::dvec3{20, 20, 20});
+    scene.useSceneSetting(SceneSetting::Cornell);
+
+    PathTracer tracer(Camera(glm::dvec3{14, 0, 0}), scene.getTree());
+    tracer.setLights(scene.getLights());
+    tracer.setSampleCount(6);
+    tracer.setThreadCount(threads);
+    tracer.setSeed(seed);
+    tracer.setPacketTracing(packets);
+    tracer.start();
+    tracer.run(40, 36);
+    tracer.stop();
+    return tracer.getImage();
+}
+
+/**
+ * Renders the cornell box with the given bounce limits and returns the counters.
+ */
+static RenderStats renderStats(const int min_bounces, const int max_bounces)
+{
+    Scene scene(".", glm::dvec3{-20, -20, -20}, glm::dvec3{20, 20, 20});
+    scene.useSceneSetting(SceneSetting::Cornell);
+
+    PathTracer tracer(Camera(glm::dvec3{14, 0, 0}), scene.getTree());
+    tracer.setSampleCount(4);
+    tracer.setBounceLimits(min_bounces, max_bounces);
+    tracer.setSeed(1);
+    tracer.start();
+    tracer.run(16, 16);
+    tracer.stop();
+    return tracer.getStats();
+}
+
+static bool identical(const Image& a, const Image& b)
+{
+    for (auto y = 0; y < a.height(); y++) {
+        for (auto x = 0; x < a.width(); x++) {
+            if (a.getPixel(x, y) != b.getPixel(x, y)) {
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+TEST(PathTracerTest, testSeededRenderIndependentOfThreadCount)
+{
+    const auto single = renderCornell(1, 42);
+    const auto multi = renderCornell(4, 42);
+    EXPECT_TRUE(identical(*single, *multi));
+}
+
+TEST(PathTracerTest, testPacketTracingMatchesSingleRays)
+{
+    const auto packets = renderCornell(2, 42, true);
+    const auto single = renderCornell(2, 42, false);
+    EXPECT_TRUE(identical(*packets, *single));
+}
+
+TEST(PathTracerTest, testSnapshotsDuringRender)
+{
+    // the viewer copies the image while the workers publish their tiles
+    Scene scene(".", glm::dvec3{-20, -20, -20}, glm::dvec3{20, 20, 20});
+    scene.useSceneSetting(SceneSetting::Cornell);
+
+    PathTracer tracer(Camera(glm::dvec3{14, 0, 0}), scene.getTree());
+    tracer.setLights(scene.getLights());
+    tracer.setSampleCount(6);
+    tracer.setThreadCount(4);
+    tracer.setSeed(42);
+    tracer.start();
+    std::atomic_bool done{false};
+    std::thread worker([&tracer, &done]() {
+        tracer.run(40, 36);
+        done = true;
+    });
+    size_t snapshots = 0;
+    while (!done) {
+        const auto snapshot = tracer.getImage();
+        EXPECT_TRUE(snapshot->width() == 0 || snapshot->width() == 40);
+        snapshots++;
+    }
+    worker.join();
+    tracer.stop();
+
+    EXPECT_GT(snapshots, 0);
+    EXPECT_TRUE(identical(*tracer.getImage(), *renderCornell(4, 42)));
+}
+
+TEST(PathTracerTest, testSeedChangesRender)
+{
+    const auto a = renderCornell(2, 42);
+    const auto b = renderCornell(2, 43);
+    EXPECT_FALSE(identical(*a, *b));
+}
+
+TEST(PathTracerTest, testRouletteAfterMinimumDepth)
+{
+    const auto stats = renderStats(2, 64);
+    EXPECT_GT(stats.paths_roulette, 0u);
+    EXPECT_GT(stats.averagePathLength(), 2.0);
+    EXPECT_EQ(stats.pathCount(), 16u * 16u * 4u);
+}
+
+TEST(PathTracerTest, testMaximumDepthWithoutRoulette)
+{
+    const auto stats = renderStats(3, 3);
+    EXPECT_EQ(stats.paths_roulette, 0u);
+    EXPECT_LE(stats.averagePathLength(), 3.0);
+    EXPECT_EQ(stats.rays[3], 0u);
+}
+
+/**
+ * Renders the cornell box with adaptive sampling and the given number of threads.
+ */
+static std::unique_ptr<PathTracer>
+renderAdaptive(const int threads, Scene& scene, const SamplerType sampler = SamplerType::Sobol)
+{
+    auto tracer = std::make_unique<PathTracer>(Camera(glm::dvec3{14, 0, 0}), scene.getTree());
+    tracer->setLights(scene.getLights());
+    tracer->setSampleCount(16);
+    tracer->setAdaptive(0.05, 4);
+    tracer->setSampler(sampler);
+    tracer->setThreadCount(threads);
+    tracer->setSeed(3);
+    tracer->start();
+    tracer->run(32, 32);
+    tracer->stop();
+    return tracer;
+}
+
+TEST(PathTracerTest, testAdaptiveSamplingKeepsBudget)
+{
+    Scene scene(".", glm::dvec3{-20, -20, -20}, glm::dvec3{20, 20, 20});
+    scene.useSceneSetting(SceneSetting::Cornell);
+    const auto tracer = renderAdaptive(2, scene);
+
+    EXPECT_LE(tracer->getStats().pathCount(), 32u * 32u * 16u);
+
+    // the flat light source converges early, the noisy pixels receive more than the average
+    const auto heatmap = tracer->getSampleHeatmap();
+    auto min_value = 3.0;
+    auto max_value = 0.0;
+    for (auto y = 0; y < heatmap->height(); y++) {
+        for (auto x = 0; x < heatmap->width(); x++) {
+            const auto p = heatmap->getPixel(x, y);
+            min_value = std::min(min_value, p.r + p.g + p.b);
+            max_value = std::max(max_value, p.r + p.g + p.b);
+        }
+    }
+    EXPECT_LT(min_value, max_value);
+    EXPECT_DOUBLE_EQ(max_value, 3.0);
+}
+
+TEST(PathTracerTest, testAdaptiveSamplingIndependentOfThreadCount)
+{
+    Scene scene(".", glm::dvec3{-20, -20, -20}, glm::dvec3{20, 20, 20});
+    scene.useSceneSetting(SceneSetting::Cornell);
+    const auto single = renderAdaptive(1, scene);
+    const auto multi = renderAdaptive(4, scene);
+    EXPECT_TRUE(identical(*single->getImage(), *multi->getImage()));
+    EXPECT_TRUE(identical(*single->getSampleHeatmap(), *multi->getSampleHeatmap()));
+}
+
+TEST(PathTracerTest, testAdaptiveSamplingWithStratifiedSampler)
+{
+    // the noisy pixels take up to 8 times the sample count, i.e. more samples than strata
+    Scene scene(".", glm::dvec3{-20, -20, -20}, glm::dvec3{20, 20, 20});
+    scene.useSceneSetting(SceneSetting::Cornell);
+    const auto stratified = renderAdaptive(2, scene, SamplerType::Stratified);
+    const auto reference = renderAdaptive(2, scene, SamplerType::Independent);
+
+    EXPECT_LE(stratified->getStats().pathCount(), 32u * 32u * 16u);
+    const auto heatmap = stratified->getSampleHeatmap();
+    auto mean = 0.0;
+    auto reference_mean = 0.0;
+    auto max_value = 0.0;
+    const auto image = stratified->getImage();
+    const auto reference_image = reference->getImage();
+    for (auto y = 0; y < image->height(); y++) {
+        for (auto x = 0; x < image->width(); x++) {
+            const auto p = heatmap->getPixel(x, y);
+            max_value = std::max(max_value, p.r + p.g + p.b);
+            mean += glm::dot(image->getPixel(x, y), glm::dvec3(1, 1, 1));
+            reference_mean += glm::dot(reference_image->getPixel(x, y), glm::dvec3(1, 1, 1));
+        }
+    }
+    EXPECT_DOUBLE_EQ(max_value, 3.0);
+    EXPECT_NEAR(mean / reference_mean, 1.0, 0.02);
+}
+
+TEST(PathTracerTest, testErrorTargetStopsAtPassBoundary)
+{
+    Scene scene(".", glm::dvec3{-20, -20, -20}, glm::dvec3{20, 20, 20});
+    scene.useSceneSetting(SceneSetting::Cornell);
+
+    PathTracer tracer(Camera(glm::dvec3{14, 0, 0}), scene.getTree());
+    tracer.setLights(scene.getLights());
+    tracer.setErrorTarget(0.5);
+    tracer.setSeed(5);
+    tracer.start();
+    tracer.run(16, 16);
+    tracer.stop();
+
+    const auto progress = tracer.getProgress();
+    EXPECT_LE(progress.error, 0.5);
+    EXPECT_GE(progress.samples_per_pixel, 16.0);
+    EXPECT_DOUBLE_EQ(progress.samples_per_pixel, std::floor(progress.samples_per_pixel));
+    EXPECT_DOUBLE_EQ(static_cast<double>(tracer.getStats().pathCount()),
+                     16 * 16 * progress.samples_per_pixel);
+}
+
+TEST(PathTracerTest, testTimeBudget)
+{
+    Scene scene(".", glm::dvec3{-20, -20, -20}, glm::dvec3{20, 20, 20});
+    scene.useSceneSetting(SceneSetting::Cornell);
+
+    PathTracer tracer(Camera(glm::dvec3{14, 0, 0}), scene.getTree());
+    tracer.setLights(scene.getLights());
+    tracer.setSampleCount(1);
+    tracer.setTimeBudget(0.2);
+    tracer.start();
+    tracer.run(16, 16);
+    tracer.stop();
+
+    // The budget ends the frame at a pass boundary, after at least one pass and long before the
+    // upper sample limit. The wall-clock time itself depends on the load of the machine.
+    const auto progress = tracer.getProgress();
+    EXPECT_GE(progress.samples_per_pixel, 1.0);
+    EXPECT_LT(progress.samples_per_pixel, 1 << 16);
+    EXPECT_DOUBLE_EQ(progress.samples_per_pixel, std::floor(progress.samples_per_pixel));
+    EXPECT_DOUBLE_EQ(static_cast<double>(tracer.getStats().pathCount()),
+                     16 * 16 * progress.samples_per_pixel);
+    EXPECT_GT(progress.seconds, 0.0);
+}
@@ -0,0 +1,86 @@
+/**
+ *    Copyright 2020 Jannik Bamberger
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "RenderStats.h"
+#include <gtest/gtest.h>
+#include <sstream>
+
+TEST(RenderStatsTest, testDeepRaysInLastBucket)
+{
+    RenderStats stats;
+    stats.addRay(0);
+    stats.addRay(RenderStats::depth_buckets - 1);
+    stats.addRay(RenderStats::depth_buckets + 10);
+
+    EXPECT_EQ(stats.rays[0], 1);
+    EXPECT_EQ(stats.rays[RenderStats::depth_buckets - 1], 2);
+    EXPECT_EQ(stats.rayCount(), 3);
+}
+
+TEST(RenderStatsTest, testMerge)
+{
+    RenderStats a;
+    a.addRay(1);
+    a.box_tests = 3;
+    a.paths_escaped = 1;
+    RenderStats b;
+    b.addRay(1);
+    b.primitive_tests = 5;
+    b.paths_absorbed = 2;
+
+    a += b;
+    EXPECT_EQ(a.rays[1], 2);
+    EXPECT_EQ(a.box_tests, 3);
+    EXPECT_EQ(a.primitive_tests, 5);
+    EXPECT_EQ(a.pathCount(), 3);
+}
+
+TEST(RenderStatsTest, testAveragePathLength)
+{
+    RenderStats stats;
+    stats.addRay(0);
+    stats.addRay(1);
+    stats.addRay(0);
+    stats.shadow_rays = 4;
+    stats.paths_escaped = 1;
+    stats.paths_roulette = 1;
+
+    EXPECT_EQ(stats.pathCount(), 2);
+    EXPECT_DOUBLE_EQ(stats.averagePathLength(), 1.5);
+}
+
+TEST(RenderStatsTest, testThreadLocal)
+{
+    RenderStats::local() = RenderStats();
+    RenderStats::local().bvh_nodes++;
+
+    EXPECT_EQ(RenderStats::local().bvh_nodes, 1);
+}
+
+TEST(RenderStatsTest, testJson)
+{
+    RenderStats stats;
+    stats.addRay(0);
+    stats.octree_nodes = 7;
+
+    std::ostringstream os;
+    stats.writeJson(os);
+    const auto json = os.str();
+    EXPECT_EQ(json.front(), '{');
+    EXPECT_EQ(json.back(), '}');
+    EXPECT_NE(json.find("\"rays\": 1,"), std::string::npos);
+    EXPECT_NE(json.find("\"octree_nodes\": 7,"), std::string::npos);
+}
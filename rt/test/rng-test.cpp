@@ -0,0 +1,56 @@
+/**
+ *    Copyright 2020 Jannik Bamberger
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "Pcg32.h"
+#include "RandomUtils.h"
+#include <gtest/gtest.h>
+
+TEST(RngTest, testPcg32ReferenceSequence)
+{
+    // reference output of pcg32-demo for seed 42, stream 54
+    Pcg32 pcg(42, 54);
+    const uint32_t expected[] = {0xa15c02b7, 0x7b47f409, 0xba1d3330,
+                                 0x83d2f293, 0xbfa4784b, 0xcbed606e};
+    for (const auto e : expected) {
+        EXPECT_EQ(pcg.nextUInt(), e);
+    }
+}
+
+TEST(RngTest, testDoublesInUnitInterval)
+{
+    Pcg32 pcg(7);
+    double sum = 0;
+    const int n = 100000;
+    for (int i = 0; i < n; i++) {
+        const auto r = pcg.nextDouble();
+        ASSERT_GE(r, 0.0);
+        ASSERT_LT(r, 1.0);
+        sum += r;
+    }
+    EXPECT_NEAR(sum / n, 0.5, 0.01);
+}
+
+TEST(RngTest, testSeedIsReproducible)
+{
+    seedRng(123);
+    const auto a = rng2();
+    const auto b = rng();
+    seedRng(123);
+    EXPECT_EQ(rng2(), a);
+    EXPECT_EQ(rng(), b);
+    seedRng(124);
+    EXPECT_NE(rng2(), a);
+}
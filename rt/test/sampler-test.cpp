@@ -0,0 +1,154 @@
+/**
+ *    Copyright 2020 Jannik Bamberger
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "Sampler.h"
+#include <gtest/gtest.h>
+#include <set>
+#include <vector>
+
+class SamplerTest : public ::testing::TestWithParam<SamplerType> {
+};
+
+TEST_P(SamplerTest, testValuesInUnitInterval)
+{
+    const auto sampler = makeSampler(GetParam(), 3, 64);
+    for (uint64_t i = 0; i < 64; i++) {
+        sampler->startSample(5, i);
+        for (auto d = 0; d < 40; d++) {
+            const auto x = sampler->get1D();
+            ASSERT_GE(x, 0.0);
+            ASSERT_LT(x, 1.0);
+            const auto p = sampler->get2D();
+            ASSERT_GE(p.x, 0.0);
+            ASSERT_LT(p.x, 1.0);
+            ASSERT_GE(p.y, 0.0);
+            ASSERT_LT(p.y, 1.0);
+        }
+    }
+}
+
+TEST_P(SamplerTest, testOrderIndependent)
+{
+    const auto a = makeSampler(GetParam(), 3, 16);
+    const auto b = makeSampler(GetParam(), 3, 16);
+    b->startSample(8, 2);
+    static_cast<void>(b->get2D());
+    a->startSample(7, 11);
+    b->startSample(7, 11);
+    EXPECT_EQ(a->get2D(), b->get2D());
+    EXPECT_EQ(a->get1D(), b->get1D());
+}
+
+TEST_P(SamplerTest, testMeanOfDimensions)
+{
+    const auto sampler = makeSampler(GetParam(), 11, 256);
+    const auto n = 256;
+    std::vector<double> sums(8, 0.0);
+    for (auto i = 0; i < n; i++) {
+        sampler->startSample(1, i);
+        for (auto& sum : sums) {
+            sum += sampler->get1D();
+        }
+    }
+    for (const auto sum : sums) {
+        EXPECT_NEAR(sum / n, 0.5, 0.05);
+    }
+}
+
+INSTANTIATE_TEST_SUITE_P(AllSamplers,
+                         SamplerTest,
+                         ::testing::Values(SamplerType::Independent,
+                                           SamplerType::Stratified,
+                                           SamplerType::Halton,
+                                           SamplerType::Sobol));
+
+TEST(SobolSamplerTest, testUnscrambledPoints)
+{
+    const double expected[][2] = {{0, 0}, {0.5, 0.5}, {0.25, 0.75}, {0.75, 0.25}};
+    for (uint32_t i = 0; i < 4; i++) {
+        EXPECT_DOUBLE_EQ(SobolSampler::sobol(i, 0) * 0x1p-32, expected[i][0]);
+        EXPECT_DOUBLE_EQ(SobolSampler::sobol(i, 1) * 0x1p-32, expected[i][1]);
+    }
+}
+
+/**
+ * The first 2^m points of the scrambled sequence form a (0,m,2)-net, i.e. every elementary
+ * interval of area 2^-m contains exactly one point.
+ */
+TEST(SobolSamplerTest, testScrambledPointsFormNet)
+{
+    constexpr auto m = 6;
+    constexpr auto n = 1 << m;
+    SobolSampler sampler(42);
+    for (uint32_t set = 0; set < 2; set++) {
+        std::vector<glm::dvec2> points;
+        for (auto i = 0; i < n; i++) {
+            sampler.startSample(13, i);
+            for (uint32_t s = 0; s < set; s++) {
+                static_cast<void>(sampler.get2D());
+                static_cast<void>(sampler.get2D());
+            }
+            points.push_back(sampler.get2D());
+        }
+        for (auto k = 0; k <= m; k++) {
+            const auto nx = 1 << k;
+            const auto ny = 1 << (m - k);
+            std::set<int> cells;
+            for (const auto& p : points) {
+                cells.insert(static_cast<int>(p.x * nx) * ny + static_cast<int>(p.y * ny));
+            }
+            EXPECT_EQ(cells.size(), n) << "set " << set << " shape " << nx << "x" << ny;
+        }
+    }
+}
+
+TEST(StratifiedSamplerTest, testOneSamplePerStratum)
+{
+    constexpr auto n = 50;
+    StratifiedSampler sampler(1, n);
+    std::set<int> strata;
+    for (auto i = 0; i < n; i++) {
+        sampler.startSample(3, i);
+        strata.insert(static_cast<int>(sampler.get1D() * n));
+    }
+    EXPECT_EQ(strata.size(), n);
+}
+
+TEST(StratifiedSamplerTest, testSamplesBeyondStrata)
+{
+    // e.g. adaptive sampling takes more samples than there are strata, every further block of n
+    // samples covers all strata again, but not in the order of the first block
+    constexpr auto n = 16;
+    StratifiedSampler sampler(1, n);
+    auto reordered = false;
+    for (auto block = 1; block < 8; block++) {
+        std::set<int> strata;
+        std::set<int> cells;
+        for (auto i = 0; i < n; i++) {
+            sampler.startSample(3, i);
+            const auto first = static_cast<int>(sampler.get1D() * n);
+            sampler.startSample(3, block * n + i);
+            const auto stratum = static_cast<int>(sampler.get1D() * n);
+            const auto p = sampler.get2D();
+            strata.insert(stratum);
+            cells.insert(static_cast<int>(p.x * 4) * 4 + static_cast<int>(p.y * 4));
+            reordered = reordered || stratum != first;
+        }
+        EXPECT_EQ(strata.size(), n) << "block " << block;
+        EXPECT_EQ(cells.size(), n) << "block " << block;
+    }
+    EXPECT_TRUE(reordered);
+}
@@ -0,0 +1,127 @@
+/**
+ *    Copyright 2020 Jannik Bamberger
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "Entity.h"
+#include "Pcg32.h"
+#include "TrianglePacket.h"
+
+#include <gtest/gtest.h>
+#include <vector>
+
+/**
+ * \brief Packs random triangles around the origin and shoots random rays through the origin. Both
+ * kernels must reproduce the sequential test with Triangle::intersect exactly.
+ */
+struct TrianglePacketTest : testing::TestWithParam<uint32_t> {
+    Pcg32 rng{42};
+
+    glm::dvec3 randomPoint(double scale)
+    {
+        return scale * glm::dvec3{2 * rng.nextDouble() - 1, 2 * rng.nextDouble() - 1,
+                                  2 * rng.nextDouble() - 1};
+    }
+
+    TrianglePacket makePacket(std::vector<Triangle>& triangles)
+    {
+        TrianglePacket packet;
+        for (uint32_t i = 0; i < GetParam(); i++) {
+            triangles.emplace_back(randomPoint(1), randomPoint(1), randomPoint(1));
+            const auto& t = triangles.back();
+            packet.add(t.A, t.B - t.A, t.C - t.A, 10 + i);
+        }
+        return packet;
+    }
+};
+
+TEST_P(TrianglePacketTest, testMatchesSequential)
+{
+    for (auto trial = 0; trial < 200; trial++) {
+        std::vector<Triangle> triangles;
+        const auto packet = makePacket(triangles);
+        const auto origin = randomPoint(4);
+        const Ray ray(origin, randomPoint(0.2) - origin);
+        const auto t_max = 2 + 4 * rng.nextDouble();
+
+        auto expected_hit = false;
+        uint32_t expected_lane = 0;
+        double expected_t = t_max;
+        glm::dvec2 expected_barycentric;
+        for (uint32_t i = 0; i < triangles.size(); i++) {
+            const auto& tri = triangles[i];
+            double t;
+            glm::dvec2 barycentric;
+            if (Triangle::intersect(tri.A, tri.B - tri.A, tri.C - tri.A, ray, expected_t, t,
+                                    barycentric)) {
+                expected_hit = true;
+                expected_lane = i;
+                expected_t = t;
+                expected_barycentric = barycentric;
+            }
+        }
+
+        std::vector<bool> simd{false};
+        if (TrianglePacket::simdSupported()) {
+            simd.push_back(true);
+        }
+        for (const auto use_simd : simd) {
+            uint32_t lane = 0;
+            double t = 0;
+            glm::dvec2 barycentric;
+            const auto hit = use_simd ? packet.intersectSimd(ray, t_max, lane, t, barycentric)
+                                      : packet.intersectScalar(ray, t_max, lane, t, barycentric);
+            ASSERT_EQ(hit, expected_hit);
+            if (hit) {
+                EXPECT_EQ(lane, expected_lane);
+                EXPECT_EQ(packet.index[lane], 10 + expected_lane);
+                EXPECT_EQ(t, expected_t);
+                EXPECT_EQ(barycentric, expected_barycentric);
+            }
+        }
+    }
+}
+
+TEST_P(TrianglePacketTest, testNearestLane)
+{
+    // parallel squares at increasing distance, the nearest one is stored in the last lane
+    TrianglePacket packet;
+    for (uint32_t i = 0; i < GetParam(); i++) {
+        const auto x = static_cast<double>(GetParam() - i);
+        packet.add({x, -1, -1}, {0, 4, 0}, {0, 0, 4}, i);
+    }
+    const Ray ray({-1, 0, 0}, {1, 0, 0});
+
+    uint32_t lane = 0;
+    double t = 0;
+    glm::dvec2 barycentric;
+    ASSERT_TRUE(packet.intersect(ray, 100, lane, t, barycentric));
+    EXPECT_EQ(lane, GetParam() - 1);
+    EXPECT_DOUBLE_EQ(t, 2);
+    EXPECT_FALSE(packet.intersect(ray, 2, lane, t, barycentric));
+}
+
+INSTANTIATE_TEST_SUITE_P(LaneCount, TrianglePacketTest, testing::Range(1u, 5u));
+
+TEST(TrianglePacketEmptyTest, testEmptyPacket)
+{
+    const TrianglePacket packet;
+    const Ray ray({-1, 0, 0}, {1, 0, 0});
+
+    uint32_t lane = 0;
+    double t = 0;
+    glm::dvec2 barycentric;
+    EXPECT_FALSE(packet.intersect(ray, 100, lane, t, barycentric));
+    EXPECT_FALSE(packet.intersectScalar(ray, 100, lane, t, barycentric));
+}